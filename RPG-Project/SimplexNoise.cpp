@@ -27,7 +27,10 @@
 
 #include "SimplexNoise.h"
 
+#include <algorithm>  // std::min/std::fill
+#include <cmath>    // std::llround
 #include <cstdint>  // int32_t/uint8_t
+#include <vector>
 
 /**
  * Computes the largest integer value not greater than the float one
@@ -49,64 +52,45 @@ static inline int32_t fastfloor(float fp) {
 }
 
 /**
- * Permutation table. This is just a random jumble of all numbers 0-255.
- *
- * This produce a repeatable pattern of 256, but Ken Perlin stated
- * that it is not a problem for graphic texture as the noise features disappear
- * at a distance far enough to be able to see a repeatable pattern of 256.
- *
- * This needs to be exactly the same for all instances on all platforms,
- * so it's easiest to just keep it as static explicit data.
- * This also removes the need for any initialisation of this class.
- *
- * Note that making this an uint32_t[] instead of a uint8_t[] might make the
- * code run faster on platforms with a high penalty for unaligned single
- * byte addressing. Intel x86 is generally single-byte-friendly, but
- * some other CPUs are faster with 4-aligned reads.
- * However, a char[] is smaller, which avoids cache trashing, and that
- * is probably the most important aspect on most architectures.
- * This array is accessed a *lot* by the noise functions.
- * A vector-valued noise over 3D accesses it 96 times, and a
- * float-valued 4D noise 64 times. We want this to fit in the cache!
- */
-static const uint8_t perm[256] = {
-    151, 160, 137, 91, 90, 15,
-    131, 13, 201, 95, 96, 53, 194, 233, 7, 225, 140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23,
-    190, 6, 148, 247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57, 177, 33,
-    88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165, 71, 134, 139, 48, 27, 166,
-    77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244,
-    102, 143, 54, 65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169, 200, 196,
-    135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250, 124, 123,
-    5, 202, 38, 147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42,
-    223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
-    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104, 218, 246, 97, 228,
-    251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107,
-    49, 192, 214, 31, 181, 199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254,
-    138, 236, 205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180
-};
+ * Multipliers of the lattice coordinates, one large odd constant per axis, so that the three coordinates of a
+ * corner land on unrelated bits before they are mixed
+ */
+static const uint32_t primeX = 501125321u;
+static const uint32_t primeY = 1136930381u;
+static const uint32_t primeZ = 1720413743u;
 
 /**
- * Helper function to hash an integer using the above permutation table
- *
- *  This inline function costs around 1ns, and is called N+1 times for a noise of N dimension.
+ * Helper function to hash a lattice corner and a seed
  *
- *  Using a real hash function would be better to improve the "repeatability of 256" of the above permutation table,
- * but fast integer Hash functions uses more time and have bad random properties.
+ *  The coordinates come in already multiplied by primeX, primeY and primeZ, so the other corners of a simplex
+ * only cost an add each. They are mixed with the seed by exclusive or, the high half is folded into the low one
+ * and one multiply spreads the result, whose top byte depends on every bit below it; without the fold the
+ * gradient indices of a 3D block lean measurably towards some gradients.
+ *  This replaces Ken Perlin's 256 entry permutation table: with no table to wrap around the noise does not
+ * repeat every 256 units, a seed picks another noise at no cost, and vector code computes it with one multiply
+ * per lane instead of dependent gathers.
  *
- * @param[in] i Integer value to hash
+ * @param[in] seed     seed of the noise
+ * @param[in] xPrimed  x lattice coordinate times primeX
+ * @param[in] yPrimed  y lattice coordinate times primeY (0 in 1D)
+ * @param[in] zPrimed  z lattice coordinate times primeZ (0 in 1D and 2D)
  *
  * @return 8-bits hashed value
  */
-static inline uint8_t hash(int32_t i) {
-    return perm[static_cast<uint8_t>(i)];
+static inline int32_t hash(uint32_t seed, uint32_t xPrimed, uint32_t yPrimed = 0, uint32_t zPrimed = 0) {
+    uint32_t h = seed ^ xPrimed ^ yPrimed ^ zPrimed;
+    h ^= (h >> 16);
+    return static_cast<int32_t>((h * 0x27d4eb2du) >> 24);
 }
 
-/* NOTE Gradient table to test if lookup-table are more efficient than calculs
+/**
+ * Gradient table of grad(hash, x): looking it up beats the sign branch, which a hashed
+ * gradient mispredicts half of the time
+ */
 static const float gradients1D[16] = {
-        -8.f, -7.f, -6.f, -5.f, -4.f, -3.f, -2.f, -1.f,
-         1.f,  2.f,  3.f,  4.f,  5.f,  6.f,  7.f,  8.f
+         1.f,  2.f,  3.f,  4.f,  5.f,  6.f,  7.f,  8.f,
+        -1.f, -2.f, -3.f, -4.f, -5.f, -6.f, -7.f, -8.f
 };
-*/
 
 /**
  * Helper function to compute gradients-dot-residual vectors (1D)
@@ -125,12 +109,18 @@ static const float gradients1D[16] = {
  */
 static float grad(int32_t hash, float x) {
     const int32_t h = hash & 0x0F;  // Convert low 4 bits of hash code
-    float grad = 1.0f + (h & 7);    // Gradient value 1.0, 2.0, ..., 8.0
-    if ((h & 8) != 0) grad = -grad; // Set a random sign for the gradient
-//  float grad = gradients1D[h];    // NOTE : Test of Gradient look-up table instead of the above
+    float grad = gradients1D[h];    // Gradient value 1.0, 2.0, ..., 8.0 with a random sign
     return (grad * x);              // Multiply the gradient with the distance
 }
 
+/**
+ * Gradient table of grad(hash, x, y): (+-1, +-2) for the hashes below 4, (+-2, +-1) above, looked up like gradients1D
+ */
+static const float gradients2D[8][2] = {
+    {  1.f,  2.f }, { -1.f,  2.f }, {  1.f, -2.f }, { -1.f, -2.f },
+    {  2.f,  1.f }, {  2.f, -1.f }, { -2.f,  1.f }, { -2.f, -1.f }
+};
+
 /**
  * Helper functions to compute gradients-dot-residual vectors (2D)
  *
@@ -141,12 +131,21 @@ static float grad(int32_t hash, float x) {
  * @return gradient value
  */
 static float grad(int32_t hash, float x, float y) {
-    const int32_t h = hash & 0x3F;  // Convert low 3 bits of hash code
-    const float u = h < 4 ? x : y;  // into 8 simple gradient directions,
-    const float v = h < 4 ? y : x;
-    return ((h & 1) ? -u : u) + ((h & 2) ? -2.0f * v : 2.0f * v); // and compute the dot product with (x,y).
+    const int32_t h = hash & 0x3F;  // Convert low 6 bits of hash code into 8 simple gradient directions,
+    const float* g = gradients2D[(h < 4 ? 0 : 4) | (h & 3)];
+    return g[0] * x + g[1] * y;     // and compute the dot product with (x,y).
 }
 
+/**
+ * Gradient table of grad(hash, x, y, z): the 12 edges of a cube, with 4 of them repeated to fill 16 entries
+ */
+static const float gradients3D[16][3] = {
+    {  1.f,  1.f,  0.f }, { -1.f,  1.f,  0.f }, {  1.f, -1.f,  0.f }, { -1.f, -1.f,  0.f },
+    {  1.f,  0.f,  1.f }, { -1.f,  0.f,  1.f }, {  1.f,  0.f, -1.f }, { -1.f,  0.f, -1.f },
+    {  0.f,  1.f,  1.f }, {  0.f, -1.f,  1.f }, {  0.f,  1.f, -1.f }, {  0.f, -1.f, -1.f },
+    {  1.f,  1.f,  0.f }, {  0.f, -1.f,  1.f }, { -1.f,  1.f,  0.f }, {  0.f, -1.f, -1.f }
+};
+
 /**
  * Helper functions to compute gradients-dot-residual vectors (3D)
  *
@@ -158,10 +157,8 @@ static float grad(int32_t hash, float x, float y) {
  * @return gradient value
  */
 static float grad(int32_t hash, float x, float y, float z) {
-    int h = hash & 15;     // Convert low 4 bits of hash code into 12 simple
-    float u = h < 8 ? x : y; // gradient directions, and compute dot product.
-    float v = h < 4 ? y : h == 12 || h == 14 ? x : z; // Fix repeats at h = 12 to 15
-    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+    const float* g = gradients3D[hash & 15];    // Convert low 4 bits of hash code into 12 simple
+    return g[0] * x + g[1] * y + g[2] * z;      // gradient directions, and compute dot product.
 }
 
 /**
@@ -170,10 +167,11 @@ static float grad(int32_t hash, float x, float y, float z) {
  *  Takes around 74ns on an AMD APU.
  *
  * @param[in] x float coordinate
+ * @param[in] seed seed of the noise, see hash()
  *
  * @return Noise value in the range[-1; 1], value of 0 on all integer coordinates.
  */
-float SimplexNoise::noise(float x) {
+static float noise1(float x, uint32_t seed) {
     float n0, n1;   // Noise contributions from the two "corners"
 
     // No need to skew the input space in 1D
@@ -189,13 +187,13 @@ float SimplexNoise::noise(float x) {
     float t0 = 1.0f - x0*x0;
 //  if(t0 < 0.0f) t0 = 0.0f; // not possible
     t0 *= t0;
-    n0 = t0 * t0 * grad(hash(i0), x0);
+    n0 = t0 * t0 * grad(hash(seed, static_cast<uint32_t>(i0) * primeX), x0);
 
     // Calculate the contribution from the second corner
     float t1 = 1.0f - x1*x1;
 //  if(t1 < 0.0f) t1 = 0.0f; // not possible
     t1 *= t1;
-    n1 = t1 * t1 * grad(hash(i1), x1);
+    n1 = t1 * t1 * grad(hash(seed, static_cast<uint32_t>(i1) * primeX), x1);
 
     // The maximum value of this noise is 8*(3/4)^4 = 2.53125
     // A factor of 0.395 scales to fit exactly within [-1,1]
@@ -209,10 +207,11 @@ float SimplexNoise::noise(float x) {
  *
  * @param[in] x float coordinate
  * @param[in] y float coordinate
+ * @param[in] seed seed of the noise, see hash()
  *
  * @return Noise value in the range[-1; 1], value of 0 on all integer coordinates.
  */
-float SimplexNoise::noise(float x, float y) {
+static float noise2(float x, float y, uint32_t seed) {
     float n0, n1, n2;   // Noise contributions from the three corners
 
     // Skewing/Unskewing factors for 2D
@@ -254,9 +253,11 @@ float SimplexNoise::noise(float x, float y) {
     const float y2 = y0 - 1.0f + 2.0f * G2;
 
     // Work out the hashed gradient indices of the three simplex corners
-    const int gi0 = hash(i + hash(j));
-    const int gi1 = hash(i + i1 + hash(j + j1));
-    const int gi2 = hash(i + 1 + hash(j + 1));
+    const uint32_t ip = static_cast<uint32_t>(i) * primeX;
+    const uint32_t jp = static_cast<uint32_t>(j) * primeY;
+    const int gi0 = hash(seed, ip, jp);
+    const int gi1 = hash(seed, ip + i1 * primeX, jp + j1 * primeY);
+    const int gi2 = hash(seed, ip + primeX, jp + primeY);
 
     // Calculate the contribution from the first corner
     float t0 = 0.5f - x0*x0 - y0*y0;
@@ -296,10 +297,11 @@ float SimplexNoise::noise(float x, float y) {
  * @param[in] x float coordinate
  * @param[in] y float coordinate
  * @param[in] z float coordinate
+ * @param[in] seed seed of the noise, see hash()
  *
  * @return Noise value in the range[-1; 1], value of 0 on all integer coordinates.
  */
-float SimplexNoise::noise(float x, float y, float z) {
+static float noise3(float x, float y, float z, uint32_t seed) {
     float n0, n1, n2, n3; // Noise contributions from the four corners
 
     // Skewing/Unskewing factors for 3D
@@ -356,10 +358,13 @@ float SimplexNoise::noise(float x, float y, float z) {
     float z3 = z0 - 1.0f + 3.0f * G3;
 
     // Work out the hashed gradient indices of the four simplex corners
-    int gi0 = hash(i + hash(j + hash(k)));
-    int gi1 = hash(i + i1 + hash(j + j1 + hash(k + k1)));
-    int gi2 = hash(i + i2 + hash(j + j2 + hash(k + k2)));
-    int gi3 = hash(i + 1 + hash(j + 1 + hash(k + 1)));
+    const uint32_t ip = static_cast<uint32_t>(i) * primeX;
+    const uint32_t jp = static_cast<uint32_t>(j) * primeY;
+    const uint32_t kp = static_cast<uint32_t>(k) * primeZ;
+    int gi0 = hash(seed, ip, jp, kp);
+    int gi1 = hash(seed, ip + i1 * primeX, jp + j1 * primeY, kp + k1 * primeZ);
+    int gi2 = hash(seed, ip + i2 * primeX, jp + j2 * primeY, kp + k2 * primeZ);
+    int gi3 = hash(seed, ip + primeX, jp + primeY, kp + primeZ);
 
     // Calculate the contribution from the four corners
     float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0;
@@ -396,6 +401,548 @@ float SimplexNoise::noise(float x, float y, float z) {
     return 32.0f*(n0 + n1 + n2 + n3);
 }
 
+/**
+ * Helper functions to get the gradient vector grad() dots with the residual (2D and 3D)
+ *
+ * @param[in]  hash  hash value
+ * @param[out] g     the gradient, such that grad(hash, x, y[, z]) == g . (x, y[, z])
+ */
+static inline void gradVector(int32_t hash, float& gx, float& gy) {
+    const int32_t h = hash & 0x3F;
+    const float* g = gradients2D[(h < 4 ? 0 : 4) | (h & 3)];
+    gx = g[0];
+    gy = g[1];
+}
+
+static inline void gradVector(int32_t hash, float& gx, float& gy, float& gz) {
+    const float* g = gradients3D[hash & 15];
+    gx = g[0];
+    gy = g[1];
+    gz = g[2];
+}
+
+/**
+ * 2D Perlin simplex noise and its gradient
+ *
+ *  Each corner contributes t^4 * (g . d), with t = 0.5 - |d|^2, d the distance to the corner and g its gradient,
+ *  whose derivative is t^4 * g - 8 * t^3 * (g . d) * d. Both are summed in the same pass over the corners.
+ *
+ * @param[in]  x         float coordinate
+ * @param[in]  y         float coordinate
+ * @param[out] gradient  d/dx and d/dy of the noise, 2 floats
+ * @param[in]  seed      seed of the noise, see hash()
+ *
+ * @return Noise value, the same as noise2(x, y, seed)
+ */
+static float noiseGradient2(float x, float y, float* gradient, uint32_t seed) {
+    static const float F2 = 0.366025403f;  // F2 = (sqrt(3) - 1) / 2
+    static const float G2 = 0.211324865f;  // G2 = (3 - sqrt(3)) / 6   = F2 / (1 + 2 * K)
+
+    const float s = (x + y) * F2;
+    const int32_t i = fastfloor(x + s);
+    const int32_t j = fastfloor(y + s);
+    const float t = static_cast<float>(i + j) * G2;
+    const float x0 = x - (i - t);
+    const float y0 = y - (j - t);
+    const int32_t i1 = x0 > y0 ? 1 : 0;
+    const int32_t j1 = 1 - i1;
+
+    const float dx[3] = { x0, x0 - i1 + G2, x0 - 1.0f + 2.0f * G2 };
+    const float dy[3] = { y0, y0 - j1 + G2, y0 - 1.0f + 2.0f * G2 };
+    const uint32_t ip = static_cast<uint32_t>(i) * primeX;
+    const uint32_t jp = static_cast<uint32_t>(j) * primeY;
+    const int gi[3] = { hash(seed, ip, jp), hash(seed, ip + i1 * primeX, jp + j1 * primeY), hash(seed, ip + primeX, jp + primeY) };
+
+    float n = 0.0f;
+    gradient[0] = gradient[1] = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float tc = 0.5f - dx[c]*dx[c] - dy[c]*dy[c];
+        if (tc < 0.0f)
+            continue;
+        float g[2];
+        gradVector(gi[c], g[0], g[1]);
+        const float dot = g[0] * dx[c] + g[1] * dy[c];  // grad(gi[c], dx[c], dy[c])
+        const float t2 = tc * tc;
+        const float t4 = t2 * t2;
+        n += t4 * dot;
+        const float slope = -8.0f * t2 * tc * dot;
+        gradient[0] += t4 * g[0] + slope * dx[c];
+        gradient[1] += t4 * g[1] + slope * dy[c];
+    }
+    gradient[0] *= 45.23065f;
+    gradient[1] *= 45.23065f;
+    return 45.23065f * n;
+}
+
+/**
+ * 3D Perlin simplex noise and its gradient, worked out like the 2D one with t = 0.6 - |d|^2
+ *
+ * @param[in]  x         float coordinate
+ * @param[in]  y         float coordinate
+ * @param[in]  z         float coordinate
+ * @param[out] gradient  d/dx, d/dy and d/dz of the noise, 3 floats
+ * @param[in]  seed      seed of the noise, see hash()
+ *
+ * @return Noise value, the same as noise3(x, y, z, seed)
+ */
+static float noiseGradient3(float x, float y, float z, float* gradient, uint32_t seed) {
+    static const float F3 = 1.0f / 3.0f;
+    static const float G3 = 1.0f / 6.0f;
+
+    float s = (x + y + z) * F3;
+    int i = fastfloor(x + s);
+    int j = fastfloor(y + s);
+    int k = fastfloor(z + s);
+    float t = (i + j + k) * G3;
+    float x0 = x - (i - t);
+    float y0 = y - (j - t);
+    float z0 = z - (k - t);
+
+    // the same simplex selection as noise3(x, y, z, seed)
+    int i1, j1, k1;
+    int i2, j2, k2;
+    if (x0 >= y0) {
+        if (y0 >= z0) {
+            i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0;
+        } else if (x0 >= z0) {
+            i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1;
+        } else {
+            i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1;
+        }
+    } else {
+        if (y0 < z0) {
+            i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1;
+        } else if (x0 < z0) {
+            i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1;
+        } else {
+            i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0;
+        }
+    }
+
+    const float dx[4] = { x0, x0 - i1 + G3, x0 - i2 + 2.0f * G3, x0 - 1.0f + 3.0f * G3 };
+    const float dy[4] = { y0, y0 - j1 + G3, y0 - j2 + 2.0f * G3, y0 - 1.0f + 3.0f * G3 };
+    const float dz[4] = { z0, z0 - k1 + G3, z0 - k2 + 2.0f * G3, z0 - 1.0f + 3.0f * G3 };
+    const uint32_t ip = static_cast<uint32_t>(i) * primeX;
+    const uint32_t jp = static_cast<uint32_t>(j) * primeY;
+    const uint32_t kp = static_cast<uint32_t>(k) * primeZ;
+    const int gi[4] = { hash(seed, ip, jp, kp), hash(seed, ip + i1 * primeX, jp + j1 * primeY, kp + k1 * primeZ),
+                        hash(seed, ip + i2 * primeX, jp + j2 * primeY, kp + k2 * primeZ),
+                        hash(seed, ip + primeX, jp + primeY, kp + primeZ) };
+
+    float n = 0.0f;
+    gradient[0] = gradient[1] = gradient[2] = 0.0f;
+    for (int c = 0; c < 4; c++) {
+        float tc = 0.6f - dx[c]*dx[c] - dy[c]*dy[c] - dz[c]*dz[c];
+        if (tc < 0.0f)
+            continue;
+        float g[3];
+        gradVector(gi[c], g[0], g[1], g[2]);
+        const float dot = g[0] * dx[c] + g[1] * dy[c] + g[2] * dz[c];  // grad(gi[c], dx[c], dy[c], dz[c])
+        const float t2 = tc * tc;
+        const float t4 = t2 * t2;
+        n += t4 * dot;
+        const float slope = -8.0f * t2 * tc * dot;
+        gradient[0] += t4 * g[0] + slope * dx[c];
+        gradient[1] += t4 * g[1] + slope * dy[c];
+        gradient[2] += t4 * g[2] + slope * dz[c];
+    }
+    gradient[0] *= 32.0f;
+    gradient[1] *= 32.0f;
+    gradient[2] *= 32.0f;
+    return 32.0f * n;
+}
+
+/**
+ * 1D, 2D and 3D Perlin simplex noise, and the 2D and 3D noise with their gradient, of seed 0
+ */
+float SimplexNoise::noise(float x) {
+    return noise1(x, 0);
+}
+
+float SimplexNoise::noise(float x, float y) {
+    return noise2(x, y, 0);
+}
+
+float SimplexNoise::noise(float x, float y, float z) {
+    return noise3(x, y, z, 0);
+}
+
+float SimplexNoise::noiseGradient(float x, float y, float* gradient) {
+    return noiseGradient2(x, y, gradient, 0);
+}
+
+float SimplexNoise::noiseGradient(float x, float y, float z, float* gradient) {
+    return noiseGradient3(x, y, z, gradient, 0);
+}
+
+/*
+ * Batched 3D noise
+ *
+ * The vector kernels below run the steps of noise3(x, y, z, seed) lane by lane, in the same order of
+ * operations, so they agree with it to the last bit unless the compiler contracts the scalar code into fused
+ * multiply-adds. The simplex and gradient selection branches become compare masks and blends.
+ * Points left over at the end of a batch go through the scalar function.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMPLEX_NOISE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SIMPLEX_TARGET(isa)
+#else
+#define SIMPLEX_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define SIMPLEX_NOISE_X86 0
+#endif
+
+typedef void (*NoiseBatchKernel)(const float* x, const float* y, const float* z, float* out, size_t count, uint32_t seed);
+/// out[n] += amplitude * noise3(x[n], y, z, seed), the inner loop of SimplexNoise::fractalLattice()
+typedef void (*NoiseRowKernel)(const float* x, float y, float z, float amplitude, float* out, size_t count, uint32_t seed);
+
+static void noiseBatchScalar(const float* x, const float* y, const float* z, float* out, size_t count, uint32_t seed) {
+    for (size_t n = 0; n < count; n++) {
+        out[n] = noise3(x[n], y[n], z[n], seed);
+    }
+}
+
+static void noiseRowScalar(const float* x, float y, float z, float amplitude, float* out, size_t count, uint32_t seed) {
+    for (size_t n = 0; n < count; n++) {
+        out[n] += (amplitude * noise3(x[n], y, z, seed));
+    }
+}
+
+#if SIMPLEX_NOISE_X86
+
+/**
+ * 4 lanes of hash(seed, xPrimed, yPrimed, zPrimed)
+ */
+SIMPLEX_TARGET("sse4.1")
+static inline __m128i hash4(__m128i seed, __m128i xPrimed, __m128i yPrimed, __m128i zPrimed) {
+    __m128i h = _mm_xor_si128(_mm_xor_si128(seed, xPrimed), _mm_xor_si128(yPrimed, zPrimed));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    return _mm_srli_epi32(_mm_mullo_epi32(h, _mm_set1_epi32(0x27d4eb2d)), 24);
+}
+
+/**
+ * 4 lanes of grad(hash, x, y, z)
+ */
+SIMPLEX_TARGET("sse4.1")
+static inline __m128 grad4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+    const __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    const __m128 hAbove7 = _mm_castsi128_ps(_mm_cmpgt_epi32(h, _mm_set1_epi32(7)));
+    const __m128 hAbove3 = _mm_castsi128_ps(_mm_cmpgt_epi32(h, _mm_set1_epi32(3)));
+    const __m128 h12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+                                                         _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+    const __m128 u = _mm_blendv_ps(x, y, hAbove7);
+    const __m128 v = _mm_blendv_ps(y, _mm_blendv_ps(z, x, h12or14), hAbove3);
+    // bits 0 and 1 of h flip the sign bits of u and v
+    const __m128 uSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+    const __m128 vSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(u, uSign), _mm_xor_ps(v, vSign));
+}
+
+/**
+ * 4 lanes of the contribution of one simplex corner
+ */
+SIMPLEX_TARGET("sse4.1")
+static inline __m128 corner4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+    __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    const __m128 inside = _mm_cmpge_ps(t, _mm_setzero_ps());
+    t = _mm_mul_ps(t, t);
+    return _mm_and_ps(inside, _mm_mul_ps(_mm_mul_ps(t, t), grad4(hash, x, y, z)));
+}
+
+/**
+ * 4 lanes of noise3(x, y, z, seed)
+ */
+SIMPLEX_TARGET("sse4.1")
+static inline __m128 noise4(__m128 x, __m128 y, __m128 z, __m128i seed) {
+    const __m128 F3 = _mm_set1_ps(1.0f / 3.0f);
+    const __m128 G3 = _mm_set1_ps(1.0f / 6.0f);
+    const __m128 G3x2 = _mm_set1_ps(2.0f * (1.0f / 6.0f));
+    const __m128 G3x3 = _mm_set1_ps(3.0f * (1.0f / 6.0f));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    // Skew the input space to determine which simplex cell we're in
+    const __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), F3);
+    const __m128i i = _mm_cvtps_epi32(_mm_floor_ps(_mm_add_ps(x, s)));
+    const __m128i j = _mm_cvtps_epi32(_mm_floor_ps(_mm_add_ps(y, s)));
+    const __m128i k = _mm_cvtps_epi32(_mm_floor_ps(_mm_add_ps(z, s)));
+    const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), G3);
+    const __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+    const __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+    const __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+    // Masks of the offsets of the second and third corners, same tie breaking as the scalar branches
+    const __m128 a = _mm_cmpge_ps(x0, y0);
+    const __m128 b = _mm_cmpge_ps(y0, z0);
+    const __m128 c = _mm_cmpge_ps(x0, z0);
+    const __m128 i1 = _mm_and_ps(a, _mm_or_ps(b, c));
+    const __m128 j1 = _mm_andnot_ps(a, b);
+    const __m128 k1 = _mm_andnot_ps(_mm_or_ps(b, _mm_and_ps(a, c)), all);
+    const __m128 i2 = _mm_or_ps(a, _mm_and_ps(b, c));
+    const __m128 j2 = _mm_andnot_ps(_mm_andnot_ps(b, a), all);
+    const __m128 k2 = _mm_or_ps(_mm_andnot_ps(b, a), _mm_andnot_ps(_mm_or_ps(a, _mm_and_ps(b, c)), all));
+
+    const __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i1, one)), G3);
+    const __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j1, one)), G3);
+    const __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k1, one)), G3);
+    const __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i2, one)), G3x2);
+    const __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j2, one)), G3x2);
+    const __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k2, one)), G3x2);
+    const __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, one), G3x3);
+    const __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, one), G3x3);
+    const __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, one), G3x3);
+
+    // Hashed gradient indices of the four corners; a set mask lane keeps the prime, which steps to the next corner
+    const __m128i px = _mm_set1_epi32((int32_t)primeX);
+    const __m128i py = _mm_set1_epi32((int32_t)primeY);
+    const __m128i pz = _mm_set1_epi32((int32_t)primeZ);
+    const __m128i ip = _mm_mullo_epi32(i, px);
+    const __m128i jp = _mm_mullo_epi32(j, py);
+    const __m128i kp = _mm_mullo_epi32(k, pz);
+    const __m128i gi0 = hash4(seed, ip, jp, kp);
+    const __m128i gi1 = hash4(seed, _mm_add_epi32(ip, _mm_and_si128(_mm_castps_si128(i1), px)),
+                              _mm_add_epi32(jp, _mm_and_si128(_mm_castps_si128(j1), py)),
+                              _mm_add_epi32(kp, _mm_and_si128(_mm_castps_si128(k1), pz)));
+    const __m128i gi2 = hash4(seed, _mm_add_epi32(ip, _mm_and_si128(_mm_castps_si128(i2), px)),
+                              _mm_add_epi32(jp, _mm_and_si128(_mm_castps_si128(j2), py)),
+                              _mm_add_epi32(kp, _mm_and_si128(_mm_castps_si128(k2), pz)));
+    const __m128i gi3 = hash4(seed, _mm_add_epi32(ip, px), _mm_add_epi32(jp, py), _mm_add_epi32(kp, pz));
+
+    // Add contributions from each corner; the result is scaled to stay just inside [-1,1]
+    __m128 sum = _mm_add_ps(corner4(gi0, x0, y0, z0), corner4(gi1, x1, y1, z1));
+    sum = _mm_add_ps(_mm_add_ps(sum, corner4(gi2, x2, y2, z2)), corner4(gi3, x3, y3, z3));
+    return _mm_mul_ps(_mm_set1_ps(32.0f), sum);
+}
+
+SIMPLEX_TARGET("sse4.1")
+static void noiseBatchSse41(const float* px, const float* py, const float* pz, float* out, size_t count, uint32_t seed) {
+    const __m128i seeds = _mm_set1_epi32((int32_t)seed);
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4) {
+        _mm_storeu_ps(out + n, noise4(_mm_loadu_ps(px + n), _mm_loadu_ps(py + n), _mm_loadu_ps(pz + n), seeds));
+    }
+    noiseBatchScalar(px + n, py + n, pz + n, out + n, count - n, seed);
+}
+
+SIMPLEX_TARGET("sse4.1")
+static void noiseRowSse41(const float* px, float y, float z, float amplitude, float* out, size_t count, uint32_t seed) {
+    const __m128 ys = _mm_set1_ps(y);
+    const __m128 zs = _mm_set1_ps(z);
+    const __m128 amplitudes = _mm_set1_ps(amplitude);
+    const __m128i seeds = _mm_set1_epi32((int32_t)seed);
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4) {
+        const __m128 value = noise4(_mm_loadu_ps(px + n), ys, zs, seeds);
+        _mm_storeu_ps(out + n, _mm_add_ps(_mm_loadu_ps(out + n), _mm_mul_ps(amplitudes, value)));
+    }
+    noiseRowScalar(px + n, y, z, amplitude, out + n, count - n, seed);
+}
+
+/**
+ * 8 lanes of hash(seed, xPrimed, yPrimed, zPrimed)
+ */
+SIMPLEX_TARGET("avx2")
+static inline __m256i hash8(__m256i seed, __m256i xPrimed, __m256i yPrimed, __m256i zPrimed) {
+    __m256i h = _mm256_xor_si256(_mm256_xor_si256(seed, xPrimed), _mm256_xor_si256(yPrimed, zPrimed));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    return _mm256_srli_epi32(_mm256_mullo_epi32(h, _mm256_set1_epi32(0x27d4eb2d)), 24);
+}
+
+/**
+ * 8 lanes of grad(hash, x, y, z)
+ */
+SIMPLEX_TARGET("avx2")
+static inline __m256 grad8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+    const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    const __m256 hAbove7 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(7)));
+    const __m256 hAbove3 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(3)));
+    const __m256 h12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)),
+                                                               _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+    const __m256 u = _mm256_blendv_ps(x, y, hAbove7);
+    const __m256 v = _mm256_blendv_ps(y, _mm256_blendv_ps(z, x, h12or14), hAbove3);
+    // bits 0 and 1 of h flip the sign bits of u and v
+    const __m256 uSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+    const __m256 vSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+    return _mm256_add_ps(_mm256_xor_ps(u, uSign), _mm256_xor_ps(v, vSign));
+}
+
+/**
+ * 8 lanes of the contribution of one simplex corner
+ */
+SIMPLEX_TARGET("avx2")
+static inline __m256 corner8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+    __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)),
+                             _mm256_mul_ps(z, z));
+    const __m256 inside = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ);
+    t = _mm256_mul_ps(t, t);
+    return _mm256_and_ps(inside, _mm256_mul_ps(_mm256_mul_ps(t, t), grad8(hash, x, y, z)));
+}
+
+/**
+ * 8 lanes of noise3(x, y, z, seed)
+ */
+SIMPLEX_TARGET("avx2")
+static inline __m256 noise8(__m256 x, __m256 y, __m256 z, __m256i seed) {
+    const __m256 F3 = _mm256_set1_ps(1.0f / 3.0f);
+    const __m256 G3 = _mm256_set1_ps(1.0f / 6.0f);
+    const __m256 G3x2 = _mm256_set1_ps(2.0f * (1.0f / 6.0f));
+    const __m256 G3x3 = _mm256_set1_ps(3.0f * (1.0f / 6.0f));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    // Skew the input space to determine which simplex cell we're in
+    const __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), F3);
+    const __m256i i = _mm256_cvtps_epi32(_mm256_floor_ps(_mm256_add_ps(x, s)));
+    const __m256i j = _mm256_cvtps_epi32(_mm256_floor_ps(_mm256_add_ps(y, s)));
+    const __m256i k = _mm256_cvtps_epi32(_mm256_floor_ps(_mm256_add_ps(z, s)));
+    const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i, j), k)), G3);
+    const __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+    const __m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+    const __m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(_mm256_cvtepi32_ps(k), t));
+
+    // Masks of the offsets of the second and third corners, same tie breaking as the scalar branches
+    const __m256 a = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+    const __m256 b = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+    const __m256 c = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+    const __m256 i1 = _mm256_and_ps(a, _mm256_or_ps(b, c));
+    const __m256 j1 = _mm256_andnot_ps(a, b);
+    const __m256 k1 = _mm256_andnot_ps(_mm256_or_ps(b, _mm256_and_ps(a, c)), all);
+    const __m256 i2 = _mm256_or_ps(a, _mm256_and_ps(b, c));
+    const __m256 j2 = _mm256_andnot_ps(_mm256_andnot_ps(b, a), all);
+    const __m256 k2 = _mm256_or_ps(_mm256_andnot_ps(b, a), _mm256_andnot_ps(_mm256_or_ps(a, _mm256_and_ps(b, c)), all));
+
+    const __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(i1, one)), G3);
+    const __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(j1, one)), G3);
+    const __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(k1, one)), G3);
+    const __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(i2, one)), G3x2);
+    const __m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(j2, one)), G3x2);
+    const __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(k2, one)), G3x2);
+    const __m256 x3 = _mm256_add_ps(_mm256_sub_ps(x0, one), G3x3);
+    const __m256 y3 = _mm256_add_ps(_mm256_sub_ps(y0, one), G3x3);
+    const __m256 z3 = _mm256_add_ps(_mm256_sub_ps(z0, one), G3x3);
+
+    // Hashed gradient indices of the four corners; a set mask lane keeps the prime, which steps to the next corner
+    const __m256i px = _mm256_set1_epi32((int32_t)primeX);
+    const __m256i py = _mm256_set1_epi32((int32_t)primeY);
+    const __m256i pz = _mm256_set1_epi32((int32_t)primeZ);
+    const __m256i ip = _mm256_mullo_epi32(i, px);
+    const __m256i jp = _mm256_mullo_epi32(j, py);
+    const __m256i kp = _mm256_mullo_epi32(k, pz);
+    const __m256i gi0 = hash8(seed, ip, jp, kp);
+    const __m256i gi1 = hash8(seed, _mm256_add_epi32(ip, _mm256_and_si256(_mm256_castps_si256(i1), px)),
+                              _mm256_add_epi32(jp, _mm256_and_si256(_mm256_castps_si256(j1), py)),
+                              _mm256_add_epi32(kp, _mm256_and_si256(_mm256_castps_si256(k1), pz)));
+    const __m256i gi2 = hash8(seed, _mm256_add_epi32(ip, _mm256_and_si256(_mm256_castps_si256(i2), px)),
+                              _mm256_add_epi32(jp, _mm256_and_si256(_mm256_castps_si256(j2), py)),
+                              _mm256_add_epi32(kp, _mm256_and_si256(_mm256_castps_si256(k2), pz)));
+    const __m256i gi3 = hash8(seed, _mm256_add_epi32(ip, px), _mm256_add_epi32(jp, py), _mm256_add_epi32(kp, pz));
+
+    // Add contributions from each corner; the result is scaled to stay just inside [-1,1]
+    __m256 sum = _mm256_add_ps(corner8(gi0, x0, y0, z0), corner8(gi1, x1, y1, z1));
+    sum = _mm256_add_ps(_mm256_add_ps(sum, corner8(gi2, x2, y2, z2)), corner8(gi3, x3, y3, z3));
+    return _mm256_mul_ps(_mm256_set1_ps(32.0f), sum);
+}
+
+SIMPLEX_TARGET("avx2")
+static void noiseBatchAvx2(const float* px, const float* py, const float* pz, float* out, size_t count, uint32_t seed) {
+    const __m256i seeds = _mm256_set1_epi32((int32_t)seed);
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        _mm256_storeu_ps(out + n, noise8(_mm256_loadu_ps(px + n), _mm256_loadu_ps(py + n), _mm256_loadu_ps(pz + n), seeds));
+    }
+    noiseBatchScalar(px + n, py + n, pz + n, out + n, count - n, seed);
+}
+
+SIMPLEX_TARGET("avx2")
+static void noiseRowAvx2(const float* px, float y, float z, float amplitude, float* out, size_t count, uint32_t seed) {
+    const __m256 ys = _mm256_set1_ps(y);
+    const __m256 zs = _mm256_set1_ps(z);
+    const __m256 amplitudes = _mm256_set1_ps(amplitude);
+    const __m256i seeds = _mm256_set1_epi32((int32_t)seed);
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        const __m256 value = noise8(_mm256_loadu_ps(px + n), ys, zs, seeds);
+        _mm256_storeu_ps(out + n, _mm256_add_ps(_mm256_loadu_ps(out + n), _mm256_mul_ps(amplitudes, value)));
+    }
+    noiseRowScalar(px + n, y, z, amplitude, out + n, count - n, seed);
+}
+
+/**
+ * Checks which of the vector instruction sets the CPU and the operating system support
+ */
+static bool cpuHasSse41() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;  // OSXSAVE, then XMM and YMM state
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && avx && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif  // SIMPLEX_NOISE_X86
+
+struct NoiseBatchDispatch {
+    NoiseBatchKernel kernel;
+    NoiseRowKernel   rowKernel;
+    const char*      instructionSet;
+};
+
+/**
+ * Picks the widest batch kernel the CPU runs, the first time a batched function is called
+ */
+static const NoiseBatchDispatch& noiseBatchDispatch() {
+    static const NoiseBatchDispatch dispatch = []() {
+#if SIMPLEX_NOISE_X86
+        if (cpuHasAvx2()) {
+            return NoiseBatchDispatch{ noiseBatchAvx2, noiseRowAvx2, "avx2" };
+        }
+        if (cpuHasSse41()) {
+            return NoiseBatchDispatch{ noiseBatchSse41, noiseRowSse41, "sse4.1" };
+        }
+#endif
+        return NoiseBatchDispatch{ noiseBatchScalar, noiseRowScalar, "scalar" };
+    }();
+    return dispatch;
+}
+
+/**
+ * Batched 3D Perlin simplex noise
+ *
+ * @param[in]  x      x float coordinates
+ * @param[in]  y      y float coordinates
+ * @param[in]  z      z float coordinates
+ * @param[out] out    noise values in the range[-1; 1], out[n] = noise(x[n], y[n], z[n]) of seed
+ * @param[in]  count  number of points
+ * @param[in]  seed   seed of the noise, see hash()
+ */
+void SimplexNoise::noise(const float* x, const float* y, const float* z, float* out, size_t count, uint32_t seed) {
+    noiseBatchDispatch().kernel(x, y, z, out, count, seed);
+}
+
+/**
+ * @return name of the instruction set used by the batched functions: "avx2", "sse4.1" or "scalar"
+ */
+const char* SimplexNoise::batchInstructionSet() {
+    return noiseBatchDispatch().instructionSet;
+}
+
 
 /**
  * Fractal/Fractional Brownian Motion (fBm) summation of 1D Perlin Simplex noise
@@ -412,7 +959,7 @@ float SimplexNoise::fractal(size_t octaves, float x) const {
     float amplitude = mAmplitude;
 
     for (size_t i = 0; i < octaves; i++) {
-        output += (amplitude * noise(x * frequency));
+        output += (amplitude * noise1(x * frequency, mSeed));
         denom += amplitude;
 
         frequency *= mLacunarity;
@@ -438,7 +985,7 @@ float SimplexNoise::fractal(size_t octaves, float x, float y) const {
     float amplitude = mAmplitude;
 
     for (size_t i = 0; i < octaves; i++) {
-        output += (amplitude * noise(x * frequency, y * frequency));
+        output += (amplitude * noise2(x * frequency, y * frequency, mSeed));
         denom += amplitude;
 
         frequency *= mLacunarity;
@@ -465,7 +1012,181 @@ float SimplexNoise::fractal(size_t octaves, float x, float y, float z) const {
     float amplitude = mAmplitude;
 
     for (size_t i = 0; i < octaves; i++) {
-        output += (amplitude * noise(x * frequency, y * frequency, z * frequency));
+        output += (amplitude * noise3(x * frequency, y * frequency, z * frequency, mSeed));
+        denom += amplitude;
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+
+    return (output / denom);
+}
+
+/**
+ * Fractal/Fractional Brownian Motion (fBm) summation of 2D Perlin Simplex noise and its gradient
+ *
+ *  Each octave's gradient is scaled by its amplitude and by its frequency, the chain rule of noise(x * frequency).
+ *
+ * @param[in]  octaves   number of fraction of noise to sum
+ * @param[in]  x         x float coordinate
+ * @param[in]  y         y float coordinate
+ * @param[out] gradient  d/dx and d/dy of the fBm, 2 floats
+ *
+ * @return Noise value, the same as fractal(octaves, x, y)
+ */
+float SimplexNoise::fractalGradient(size_t octaves, float x, float y, float* gradient) const {
+    float output = 0.f;
+    float denom  = 0.f;
+    float frequency = mFrequency;
+    float amplitude = mAmplitude;
+    float octaveGradient[2];
+
+    gradient[0] = gradient[1] = 0.0f;
+    for (size_t i = 0; i < octaves; i++) {
+        output += (amplitude * noiseGradient2(x * frequency, y * frequency, octaveGradient, mSeed));
+        denom += amplitude;
+        gradient[0] += amplitude * frequency * octaveGradient[0];
+        gradient[1] += amplitude * frequency * octaveGradient[1];
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+
+    gradient[0] /= denom;
+    gradient[1] /= denom;
+    return (output / denom);
+}
+
+/**
+ * Fractal/Fractional Brownian Motion (fBm) summation of 3D Perlin Simplex noise and its gradient
+ *
+ * @param[in]  octaves   number of fraction of noise to sum
+ * @param[in]  x         x float coordinate
+ * @param[in]  y         y float coordinate
+ * @param[in]  z         z float coordinate
+ * @param[out] gradient  d/dx, d/dy and d/dz of the fBm, 3 floats
+ *
+ * @return Noise value, the same as fractal(octaves, x, y, z)
+ */
+float SimplexNoise::fractalGradient(size_t octaves, float x, float y, float z, float* gradient) const {
+    float output = 0.f;
+    float denom  = 0.f;
+    float frequency = mFrequency;
+    float amplitude = mAmplitude;
+    float octaveGradient[3];
+
+    gradient[0] = gradient[1] = gradient[2] = 0.0f;
+    for (size_t i = 0; i < octaves; i++) {
+        output += (amplitude * noiseGradient3(x * frequency, y * frequency, z * frequency, octaveGradient, mSeed));
+        denom += amplitude;
+        gradient[0] += amplitude * frequency * octaveGradient[0];
+        gradient[1] += amplitude * frequency * octaveGradient[1];
+        gradient[2] += amplitude * frequency * octaveGradient[2];
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+
+    gradient[0] /= denom;
+    gradient[1] /= denom;
+    gradient[2] /= denom;
+    return (output / denom);
+}
+
+/**
+ * Fractal/Fractional Brownian Motion (fBm) summation of batched 3D Perlin Simplex noise
+ *
+ *  Sums the octaves in the same order as the scalar fractal(), one octave over a block of points at a time.
+ *
+ * @param[in]  octaves  number of fraction of noise to sum
+ * @param[in]  x        x float coordinates
+ * @param[in]  y        y float coordinates
+ * @param[in]  z        z float coordinates
+ * @param[out] out      noise values in the range[-1; 1], out[n] = fractal(octaves, x[n], y[n], z[n])
+ * @param[in]  count    number of points
+ */
+void SimplexNoise::fractal(size_t octaves, const float* x, const float* y, const float* z, float* out, size_t count) const {
+    static const size_t blockSize = 256;  // keeps the scaled coordinates in the L1 cache
+    float xs[blockSize], ys[blockSize], zs[blockSize], values[blockSize];
+
+    for (size_t first = 0; first < count; first += blockSize) {
+        const size_t size = std::min(blockSize, count - first);
+        float* output = out + first;
+        std::fill(output, output + size, 0.f);
+        float denom = 0.f;
+        float frequency = mFrequency;
+        float amplitude = mAmplitude;
+
+        for (size_t i = 0; i < octaves; i++) {
+            for (size_t n = 0; n < size; n++) {
+                xs[n] = x[first + n] * frequency;
+                ys[n] = y[first + n] * frequency;
+                zs[n] = z[first + n] * frequency;
+            }
+            noise(xs, ys, zs, values, size, mSeed);
+            for (size_t n = 0; n < size; n++) {
+                output[n] += (amplitude * values[n]);
+            }
+            denom += amplitude;
+
+            frequency *= mLacunarity;
+            amplitude *= mPersistence;
+        }
+
+        for (size_t n = 0; n < size; n++) {
+            output[n] /= denom;
+        }
+    }
+}
+
+/**
+ * Upper bound on the gradient length of 3D fractal(octaves, x, y, z), for conservative bounds over a volume
+ *
+ *  Each of the four simplex corners adds t^4 * (g . d) with t = 0.6 - |d|^2 and |g| = sqrt(2), whose gradient
+ * is longest at d = 0, where it is sqrt(2) * 0.6^4. Scaled by 32, noise(x, y, z) changes by at most
+ * 4 * 32 * sqrt(2) * 0.6^4 = 23.46 per unit, and every octave adds amplitude * frequency times that.
+ *
+ * @param[in] octaves   number of fraction of noise to sum
+ *
+ * @return Lipschitz constant of the fractal noise
+ */
+float SimplexNoise::lipschitz(size_t octaves) const {
+    static const float noiseBound = 4.0f * 32.0f * 1.41421356f * 0.1296f;
+    float output = 0.f;
+    float denom  = 0.f;
+    float frequency = mFrequency;
+    float amplitude = mAmplitude;
+
+    for (size_t i = 0; i < octaves; i++) {
+        output += (amplitude * frequency * noiseBound);
+        denom += amplitude;
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+
+    return (output / denom);
+}
+
+/**
+ * Upper bound on the gradient length of 2D fractal(octaves, x, y), worked out like lipschitz()
+ *
+ *  Each of the three corners adds t^4 * (g . d) with t = 0.5 - |d|^2 and |g| = sqrt(5), so scaled by 45.23065
+ * noise(x, y) changes by at most 3 * 45.23065 * sqrt(5) * 0.5^4 = 18.96 per unit.
+ *
+ * @param[in] octaves   number of fraction of noise to sum
+ *
+ * @return Lipschitz constant of the 2D fractal noise
+ */
+float SimplexNoise::lipschitz2D(size_t octaves) const {
+    static const float noiseBound = 3.0f * 45.23065f * 2.23606798f * 0.0625f;
+    float output = 0.f;
+    float denom  = 0.f;
+    float frequency = mFrequency;
+    float amplitude = mAmplitude;
+
+    for (size_t i = 0; i < octaves; i++) {
+        output += (amplitude * frequency * noiseBound);
         denom += amplitude;
 
         frequency *= mLacunarity;
@@ -474,3 +1195,181 @@ float SimplexNoise::fractal(size_t octaves, float x, float y, float z) const {
 
     return (output / denom);
 }
+
+/**
+ * Octaves of a lattice evaluated only every stride-th point along each axis, for SimplexNoise::fractalLattice()
+ *
+ *  Node c along an axis sits on the lattice point c * stride - shift. The shift puts the nodes on the points
+ * whose index counted from the origin of space is a multiple of stride, so two blocks of the same lattice share
+ * their nodes and agree where they touch.
+ */
+struct CoarseLattice {
+    size_t stride;
+    size_t shift[3];
+    size_t count[3];
+    std::vector<float> values;  ///< count[0] * count[1] * count[2] summed octaves, x fastest
+
+    CoarseLattice(size_t coarseStride, const float origin[3], const float step[3], const size_t size[3]) :
+        stride(coarseStride) {
+        for (int axis = 0; axis < 3; axis++) {
+            shift[axis] = 0;
+            if (step[axis] != 0.f) {
+                const long long stride64 = (long long)stride;
+                shift[axis] = (size_t)(((std::llround(origin[axis] / step[axis]) % stride64) + stride64) % stride64);
+            }
+            count[axis] = (size[axis] - 1 + shift[axis] + stride - 1) / stride + 1;
+        }
+        values.assign(count[0] * count[1] * count[2], 0.f);
+    }
+
+    /// values += amplitude * noise at frequency over the nodes
+    void addOctave(NoiseRowKernel rowKernel, uint32_t seed, const float origin[3], const float step[3],
+                   float frequency, float amplitude, std::vector<float>& xs) {
+        xs.resize(count[0]);
+        for (size_t i = 0; i < count[0]; i++) {
+            xs[i] = (origin[0] + ((float)(i * stride) - (float)shift[0]) * step[0]) * frequency;
+        }
+        float* out = values.data();
+        for (size_t k = 0; k < count[2]; k++) {
+            const float zs = (origin[2] + ((float)(k * stride) - (float)shift[2]) * step[2]) * frequency;
+            for (size_t j = 0; j < count[1]; j++) {
+                const float ys = (origin[1] + ((float)(j * stride) - (float)shift[1]) * step[1]) * frequency;
+                rowKernel(xs.data(), ys, zs, amplitude, out + (k * count[1] + j) * count[0], count[0], seed);
+            }
+        }
+    }
+
+    /// out += the nodes trilinearly interpolated at every lattice point. Blends the four rows of nodes around a
+    /// lattice row along y and z first, then runs along x
+    void addTo(float* out, const size_t size[3]) const {
+        std::vector<size_t> node(size[0]);
+        std::vector<float> weight(size[0]);
+        std::vector<float> row(count[0]);
+        const float scale = 1.f / (float)stride;
+        for (size_t i = 0; i < size[0]; i++) {
+            node[i] = (i + shift[0]) / stride;
+            weight[i] = (float)((i + shift[0]) % stride) * scale;
+        }
+        const size_t lastX = count[0] - 1;
+        for (size_t k = 0; k < size[2]; k++) {
+            const size_t k0 = (k + shift[2]) / stride;
+            const size_t k1 = std::min(k0 + 1, count[2] - 1);
+            const float wz = (float)((k + shift[2]) % stride) * scale;
+            for (size_t j = 0; j < size[1]; j++) {
+                const size_t j0 = (j + shift[1]) / stride;
+                const size_t j1 = std::min(j0 + 1, count[1] - 1);
+                const float wy = (float)((j + shift[1]) % stride) * scale;
+                const float* v00 = values.data() + (k0 * count[1] + j0) * count[0];
+                const float* v01 = values.data() + (k0 * count[1] + j1) * count[0];
+                const float* v10 = values.data() + (k1 * count[1] + j0) * count[0];
+                const float* v11 = values.data() + (k1 * count[1] + j1) * count[0];
+                for (size_t c = 0; c < count[0]; c++) {
+                    const float near = v00[c] + wy * (v01[c] - v00[c]);
+                    const float far  = v10[c] + wy * (v11[c] - v10[c]);
+                    row[c] = near + wz * (far - near);
+                }
+                float* fine = out + (k * size[1] + j) * size[0];
+                for (size_t i = 0; i < size[0]; i++) {
+                    const size_t c = node[i];
+                    const float next = row[std::min(c + 1, lastX)];
+                    fine[i] += row[c] + weight[i] * (next - row[c]);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Fractal/Fractional Brownian Motion (fBm) summation of 3D Perlin Simplex noise over a regular lattice
+ *
+ *  Evaluates one octave across the whole block before moving to the next, so each octave runs with a single
+ * frequency. The scaled x coordinates of a row are the same for every row of the block and are computed once
+ * per octave; y and z are constant along a row and are broadcast, and the vector row kernel adds each octave
+ * straight into out.
+ *
+ *  With a maxError, every octave that changes slowly across the lattice is only evaluated every stride-th point
+ * along each axis and interpolated trilinearly in between. Trilinear interpolation over cells of sides h is off
+ * by at most (hx^2 + hy^2 + hz^2) / 8 times the largest second derivative along an axis. Each simplex corner
+ * adds t^4 * (g . d), whose second derivative along an axis stays below 0.766, so noise(x, y, z) bends by at
+ * most 4 * 32 * 0.766 = 98 per unit squared. Each octave gets an equal share of maxError and the largest power
+ * of two stride, up to 1024, that keeps within it. The low octaves, whose features span many lattice points, then cost a
+ * fraction of a full octave.
+ *
+ * @param[in]  octaves  number of fraction of noise to sum
+ * @param[in]  x        x float coordinate of the first lattice point
+ * @param[in]  y        y float coordinate of the first lattice point
+ * @param[in]  z        z float coordinate of the first lattice point
+ * @param[in]  dx       spacing of the lattice along x
+ * @param[in]  dy       spacing of the lattice along y
+ * @param[in]  dz       spacing of the lattice along z
+ * @param[in]  nx       number of lattice points along x
+ * @param[in]  ny       number of lattice points along y
+ * @param[in]  nz       number of lattice points along z
+ * @param[out] out      nx * ny * nz noise values in the range[-1; 1], out[(k * ny + j) * nx + i] is the point (i, j, k)
+ * @param[in]  maxError largest difference from fractal(octaves, x + i * dx, ...) allowed, 0 evaluates every point
+ */
+void SimplexNoise::fractalLattice(size_t octaves, float x, float y, float z, float dx, float dy, float dz,
+                                  size_t nx, size_t ny, size_t nz, float* out, float maxError) const {
+    static const float noiseCurvature = 4.0f * 32.0f * 0.766f;
+    const NoiseRowKernel rowKernel = noiseBatchDispatch().rowKernel;
+    const size_t count = nx * ny * nz;
+    const float origin[3] = { x, y, z };
+    const float step[3] = { dx, dy, dz };
+    const size_t size[3] = { nx, ny, nz };
+    std::fill(out, out + count, 0.f);
+    std::vector<float> xs(nx);
+    std::vector<CoarseLattice> coarse;
+    float denom = 0.f;
+    float amplitude = mAmplitude;
+    for (size_t octave = 0; octave < octaves; octave++) {
+        denom += amplitude;
+        amplitude *= mPersistence;
+    }
+
+    // the stride only depends on the lattice and not on the block asked for, so a plane and the rows across it
+    // interpolate from the same nodes and agree on every point
+    static const size_t maxStride = 1024;
+    const float cell2 = dx * dx + dy * dy + dz * dz;
+
+    float frequency = mFrequency;
+    amplitude = mAmplitude;
+    for (size_t octave = 0; octave < octaves; octave++) {
+        size_t stride = 1;
+        if (maxError > 0.f && cell2 > 0.f) {
+            const float bendPerStride2 = std::abs(amplitude / denom) * noiseCurvature * frequency * frequency * cell2 / 8.f;
+            const float share = maxError / (float)octaves;
+            while (stride < maxStride && bendPerStride2 * (float)(stride * stride * 4) <= share) {
+                stride *= 2;
+            }
+        }
+        if (stride == 1) {
+            for (size_t i = 0; i < nx; i++) {
+                xs[i] = (x + i * dx) * frequency;
+            }
+            for (size_t k = 0; k < nz; k++) {
+                const float zs = (z + k * dz) * frequency;
+                for (size_t j = 0; j < ny; j++) {
+                    rowKernel(xs.data(), (y + j * dy) * frequency, zs, amplitude, out + (k * ny + j) * nx, nx, mSeed);
+                }
+            }
+        } else {
+            auto level = std::find_if(coarse.begin(), coarse.end(),
+                                      [stride](const CoarseLattice& c) { return c.stride == stride; });
+            if (level == coarse.end()) {
+                coarse.emplace_back(stride, origin, step, size);
+                level = coarse.end() - 1;
+            }
+            level->addOctave(rowKernel, mSeed, origin, step, frequency, amplitude, xs);
+        }
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+    for (const CoarseLattice& level : coarse) {
+        level.addTo(out, size);
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        out[n] /= denom;
+    }
+}
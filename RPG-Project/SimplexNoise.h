@@ -10,12 +10,16 @@
 #pragma once
 
 #include <cstddef>  // size_t
+#include <cstdint>  // uint32_t
 
 /**
  * @brief A Perlin Simplex Noise C++ Implementation (1D, 2D, 3D, 4D).
  */
 class SimplexNoise {
 public:
+    // The static functions below are the noise of seed 0 unless they take one, the fBm ones use the seed given to
+    // the constructor
+
     // 1D Perlin simplex noise
     static float noise(float x);
     // 2D Perlin simplex noise
@@ -28,6 +32,32 @@ public:
     float fractal(size_t octaves, float x, float y) const;
     float fractal(size_t octaves, float x, float y, float z) const;
 
+    // Noise and fBm with their gradient, worked out analytically in the same evaluation: gradient receives
+    // d/dx, d/dy (and d/dz) of the returned value, which is the same as noise() or fractal() returns
+    static float noiseGradient(float x, float y, float* gradient);
+    static float noiseGradient(float x, float y, float z, float* gradient);
+    float fractalGradient(size_t octaves, float x, float y, float* gradient) const;
+    float fractalGradient(size_t octaves, float x, float y, float z, float* gradient) const;
+
+    // Batched 3D noise and fBm over structure-of-arrays coordinates: out[n] = noise(x[n], y[n], z[n]) for n < count
+    static void noise(const float* x, const float* y, const float* z, float* out, size_t count, uint32_t seed = 0);
+    void fractal(size_t octaves, const float* x, const float* y, const float* z, float* out, size_t count) const;
+
+    // Upper bound on how fast fractal(octaves, x, y, z) changes per unit of distance
+    float lipschitz(size_t octaves) const;
+    // The same for fractal(octaves, x, y)
+    float lipschitz2D(size_t octaves) const;
+
+    // fBm over the nx * ny * nz lattice (x + i * dx, y + j * dy, z + k * dz), x fastest in out.
+    // Every octave is summed over the whole block before the next one starts. A maxError above 0 lets the octaves
+    // that change slowly across the lattice be evaluated on a coarser one and interpolated, staying within
+    // maxError of fractal()
+    void fractalLattice(size_t octaves, float x, float y, float z, float dx, float dy, float dz,
+                        size_t nx, size_t ny, size_t nz, float* out, float maxError = 0.f) const;
+
+    // Instruction set picked at run time for the batched functions: "avx2", "sse4.1" or "scalar"
+    static const char* batchInstructionSet();
+
     /**
      * Constructor of to initialize a fractal noise summation
      *
@@ -35,15 +65,18 @@ public:
      * @param[in] amplitude    Amplitude ("height") of the first octave of noise (default to 1.0)
      * @param[in] lacunarity   Lacunarity specifies the frequency multiplier between successive octaves (default to 2.0).
      * @param[in] persistence  Persistence is the loss of amplitude between successive octaves (usually 1/lacunarity)
+     * @param[in] seed         Seed picking one of 2^32 unrelated noise fields (default to 0, the static functions' one)
      */
     explicit SimplexNoise(float frequency = 1.0f,
                           float amplitude = 1.0f,
                           float lacunarity = 2.0f,
-                          float persistence = 0.5f) :
+                          float persistence = 0.5f,
+                          uint32_t seed = 0) :
         mFrequency(frequency),
         mAmplitude(amplitude),
         mLacunarity(lacunarity),
-        mPersistence(persistence) {
+        mPersistence(persistence),
+        mSeed(seed) {
     }
 
 private:
@@ -52,4 +85,5 @@ private:
     float mAmplitude;   ///< Amplitude ("height") of the first octave of noise (default to 1.0)
     float mLacunarity;  ///< Lacunarity specifies the frequency multiplier between successive octaves (default to 2.0).
     float mPersistence; ///< Persistence is the loss of amplitude between successive octaves (usually 1/lacunarity)
+    uint32_t mSeed;     ///< Seed of the noise, hashed with the lattice coordinates (default to 0)
 };
@@ -0,0 +1,181 @@
+#ifndef ANIMATEDSURFACE_H
+#define ANIMATEDSURFACE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "marchingcubes.h"
+#include "workerpool.h"
+
+// Default animated surface values
+const int ANIMATED_RESOLUTION = 64;         // marching cubes cells along each axis of the box
+const int ANIMATED_FRAMES = 3;              // meshes in flight: the GPU draws from one while the next ones are written
+const float ANIMATED_TARGET = 48.0f;        // the isovalue fSample1..3 were made for
+const float ANIMATED_TIME_SCALE = 0.25f;    // vSetTime() units per second
+
+// A time varying density (fSample1..3 move with vSetTime()) meshed again every frame inside a box.
+// Update() meshes the box on a WorkerPool into a mesh whose buffers are kept from frame to frame, and writes it to
+// one of ANIMATED_FRAMES slots of a shared vertex and element buffer. Slots are used in turn and each is fenced
+// after the draw that reads it, so a slot is only written once the GPU is done with it: the write maps the slot
+// unsynchronized and never waits on the draws of the frames before. The buffers only grow, all slots at once,
+// when a mesh does not fit.
+// All methods must be called from the thread that owns the GL context
+class AnimatedSurface
+{
+public:
+    GLvector Min;
+    GLvector Max;
+    int Resolution;
+    float TargetValue;
+    MarchVariant Variant;
+
+    // constructor, the box from min to max is meshed on numThreads threads besides the caller
+    AnimatedSurface(const GLvector& min = { 0.0f, 0.0f, 0.0f }, const GLvector& max = { 1.0f, 1.0f, 1.0f },
+                    int resolution = ANIMATED_RESOLUTION, unsigned int numThreads = WorkerPool::DefaultThreads())
+        : Min(min), Max(max), Resolution(resolution), TargetValue(ANIMATED_TARGET), Variant(MARCH_CUBES), pool(numThreads)
+    {
+    }
+
+    ~AnimatedSurface()
+    {
+        Clear();
+    }
+
+    AnimatedSurface(const AnimatedSurface&) = delete;
+    AnimatedSurface& operator=(const AnimatedSurface&) = delete;
+
+    // meshes density at time and writes the mesh to the next slot, which Draw() then draws
+    // since this moves the time, no other mesher may run meanwhile (see ChunkManager::WaitIdle())
+    void Update(DensityFunction density, float time)
+    {
+        vSetTime(time);
+        MarchingCubesMesher mesher(density, Min, Max, Resolution, TargetValue, Variant);
+        mesher.vSetWorkerPool(&pool);
+        mesh.vClear();
+        mesher.vMesh(mesh);
+
+        slot = (slot + 1) % ANIMATED_FRAMES;
+        indexCount = (GLsizei)mesh.indices.size();
+        if (indexCount == 0)
+            return;
+
+        if (VAO == 0 || mesh.iNumOfVertices() > slotVertices || mesh.indices.size() > slotIndices)
+            allocate();
+        else if (fences[slot] != 0)
+        {
+            // with ANIMATED_FRAMES slots this frame's draw is two frames behind, so the fence has long signalled
+            while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                ;
+        }
+        if (fences[slot] != 0)
+        {
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+
+        glBindVertexArray(VAO);
+        writeSlot(GL_ARRAY_BUFFER, VBO, (GLintptr)slot * slotVertices * vertexBytes(), mesh.vertices.data(),
+                  mesh.vertices.size() * sizeof(GLfloat));
+        writeSlot(GL_ELEMENT_ARRAY_BUFFER, EBO, (GLintptr)slot * slotIndices * sizeof(GLuint), mesh.indices.data(),
+                  mesh.indices.size() * sizeof(GLuint));
+        glBindVertexArray(0);
+    }
+
+    // draws the mesh of the last Update() and fences its slot
+    void Draw()
+    {
+        if (indexCount == 0)
+            return;
+        glBindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)((size_t)slot * slotIndices * sizeof(GLuint)),
+                                 (GLint)(slot * slotVertices));
+        glBindVertexArray(0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // frees the GL objects; the next Update() makes them again
+    void Clear()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence != 0)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (VAO != 0)
+        {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+        VAO = VBO = EBO = 0;
+        slotVertices = slotIndices = 0;
+        indexCount = 0;
+    }
+
+private:
+    WorkerPool pool;
+    MarchingCubesMesh mesh;     // kept between frames, so meshing only allocates when the surface grows
+    unsigned int VAO{ 0 };
+    unsigned int VBO{ 0 };
+    unsigned int EBO{ 0 };
+    GLsync fences[ANIMATED_FRAMES]{};
+    GLuint slotVertices{ 0 };   // vertices and indices one slot has room for
+    size_t slotIndices{ 0 };
+    int slot{ 0 };              // slot written by the last Update()
+    GLsizei indexCount{ 0 };
+
+    static GLsizeiptr vertexBytes()
+    {
+        return MarchingCubesMesh::iStride * sizeof(GLfloat);
+    }
+
+    // (re)allocates every slot with room for half as much again as the current mesh. The old storage is
+    // orphaned, the draws still reading it keep it alive, so nothing waits on them
+    void allocate()
+    {
+        if (VAO == 0)
+        {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glGenBuffers(1, &EBO);
+        }
+        for (GLsync& fence : fences)
+        {
+            if (fence != 0)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        slotVertices = std::max(slotVertices, mesh.iNumOfVertices() + mesh.iNumOfVertices() / 2);
+        slotIndices = std::max(slotIndices, mesh.indices.size() + mesh.indices.size() / 2);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)ANIMATED_FRAMES * slotVertices * vertexBytes(), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(ANIMATED_FRAMES * slotIndices * sizeof(GLuint)), nullptr, GL_STREAM_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)vertexBytes(), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (GLsizei)vertexBytes(), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    // copies size bytes of data to offset of buffer, which no pending draw reads
+    static void writeSlot(GLenum target, unsigned int buffer, GLintptr offset, const void* data, size_t size)
+    {
+        glBindBuffer(target, buffer);
+        void* mapped = glMapBufferRange(target, offset, (GLsizeiptr)size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped == nullptr)
+        {
+            glBufferSubData(target, offset, (GLsizeiptr)size, data);
+            return;
+        }
+        std::memcpy(mapped, data, size);
+        glUnmapBuffer(target);
+    }
+};
+#endif
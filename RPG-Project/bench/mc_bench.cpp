@@ -0,0 +1,294 @@
+// mc_bench: meshes each density source without a window or GL context and prints the throughput as JSON.
+//
+// usage: mc_bench [--resolutions 16,32,64,128] [--threads 1,2,4] [--repeat 5] [--variant cubes|tetrahedra|both]
+//                 [--stream batch_triangles] [--grid-normals]
+//
+// Every combination of source, variant, resolution and thread count is one result. A result times vMesh()
+// (sampling, empty space skipping and meshing) and vSampleGrid() on its own, best of --repeat runs after a warm-up,
+// and records the most heap memory the mesher held on top of what was allocated before the run.
+// --stream times vMeshStream() into a sink that only counts instead, and leaves vSampleGrid() out, so
+// resolutions of 512 and more fit in memory. --grid-normals turns vSetExactNormals() off.
+#include "marchingcubes.h"
+#include "densitygraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Heap accounting: every allocation goes through these, so peakBytes is the most ever held at once
+static std::atomic<size_t> heapBytes{ 0 };
+static std::atomic<size_t> peakBytes{ 0 };
+
+// a block is its size in a 16 byte header, which keeps the pointer handed out aligned like malloc's
+static const size_t HEAP_HEADER = 16;
+
+void* operator new(size_t size)
+{
+    unsigned char* block = (unsigned char*)std::malloc(size + HEAP_HEADER);
+    if (block == nullptr)
+        throw std::bad_alloc();
+    std::memcpy(block, &size, sizeof(size));
+    size_t held = heapBytes += size;
+    size_t peak = peakBytes.load();
+    while (held > peak && !peakBytes.compare_exchange_weak(peak, held))
+        ;
+    return block + HEAP_HEADER;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (pointer == nullptr)
+        return;
+    unsigned char* block = (unsigned char*)pointer - HEAP_HEADER;
+    size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    heapBytes -= size;
+    std::free(block);
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+// A density source and the box and isovalue it is meshed at
+struct BenchSource {
+    const char* name;
+    DensityFunction density;
+    GLvector min;
+    GLvector max;
+    float targetValue;
+};
+
+struct BenchResult {
+    std::string source;
+    const char* variant;
+    int resolution;
+    int threads;
+    unsigned int vertices;
+    unsigned int triangles;
+    double meshMs;      // best vMesh() time
+    double sampleMs;    // best vSampleGrid() time, or 0 when streaming
+    size_t peakBytes;
+};
+
+static std::vector<int> parseList(const char* text)
+{
+    std::vector<int> values;
+    for (const char* p = text; *p != '\0';)
+    {
+        char* end;
+        long value = std::strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (value > 0)
+            values.push_back((int)value);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static BenchResult run(const BenchSource& source, MarchVariant variant, int resolution, int threads, int repeat,
+                       unsigned int streamBatch, bool gridNormals)
+{
+    // the calling thread works too, so threads - 1 extra ones
+    WorkerPool pool(threads - 1);
+    MarchingCubesMesher mesher(source.density, source.min, source.max, resolution, source.targetValue, variant);
+    mesher.vSetWorkerPool(&pool);
+    mesher.vSetExactNormals(!gridNormals);
+
+    BenchResult result;
+    result.source = source.name;
+    result.variant = variant == MARCH_TETRAHEDRA ? "tetrahedra" : "cubes";
+    result.resolution = resolution;
+    result.threads = threads;
+    result.meshMs = 1e30;
+    result.sampleMs = 1e30;
+    result.peakBytes = 0;
+
+    if (streamBatch > 0)
+    {
+        unsigned int vertices = 0, triangles = 0;
+        MeshBatchSink count = [&](const MarchingCubesMesh& batch, GLuint) {
+            vertices += batch.iNumOfVertices();
+            triangles += batch.iNumOfTriangles();
+        };
+        for (int i = 0; i <= repeat; i++)
+        {
+            vertices = triangles = 0;
+            size_t before = heapBytes;
+            peakBytes = before;
+            auto start = std::chrono::steady_clock::now();
+            mesher.vMeshStream(count, streamBatch);
+            // the first run only warms up
+            if (i > 0)
+                result.meshMs = std::min(result.meshMs, millisecondsSince(start));
+            result.peakBytes = std::max(result.peakBytes, peakBytes - before);
+        }
+        result.vertices = vertices;
+        result.triangles = triangles;
+        result.sampleMs = 0.0;
+        return result;
+    }
+
+    MarchingCubesMesh mesh;
+    mesher.vMesh(mesh);
+    for (int i = 0; i < repeat; i++)
+    {
+        mesh = MarchingCubesMesh();
+        size_t before = heapBytes;
+        peakBytes = before;
+        auto start = std::chrono::steady_clock::now();
+        mesher.vMesh(mesh);
+        result.meshMs = std::min(result.meshMs, millisecondsSince(start));
+        result.peakBytes = std::max(result.peakBytes, peakBytes - before);
+    }
+    result.vertices = mesh.iNumOfVertices();
+    result.triangles = mesh.iNumOfTriangles();
+
+    std::vector<GLfloat> grid;
+    for (int i = 0; i < repeat; i++)
+    {
+        grid = std::vector<GLfloat>();
+        auto start = std::chrono::steady_clock::now();
+        mesher.vSampleGrid(grid);
+        result.sampleMs = std::min(result.sampleMs, millisecondsSince(start));
+    }
+    return result;
+}
+
+static long maxResidentKb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> resolutions{ 16, 32, 64, 128 };
+    std::vector<int> threads{ 1, 2, 4 };
+    std::vector<MarchVariant> variants{ MARCH_CUBES, MARCH_TETRAHEDRA };
+    int repeat = 5;
+    unsigned int streamBatch = 0;
+    bool gridNormals = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--resolutions") == 0 && hasValue)
+            resolutions = parseList(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+            threads = parseList(argv[++i]);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue)
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--variant") == 0 && hasValue)
+        {
+            std::string variant = argv[++i];
+            if (variant == "cubes")
+                variants = { MARCH_CUBES };
+            else if (variant == "tetrahedra")
+                variants = { MARCH_TETRAHEDRA };
+        }
+        else if (std::strcmp(argv[i], "--stream") == 0 && hasValue)
+            streamBatch = (unsigned int)std::max(std::atol(argv[++i]), 1L);
+        else if (std::strcmp(argv[i], "--grid-normals") == 0)
+            gridNormals = true;
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--resolutions 16,32,64,128] [--threads 1,2,4] [--repeat 5] "
+                                 "[--variant cubes|tetrahedra|both] [--stream batch_triangles] [--grid-normals]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // fSample1..3 at the isovalue of the original Marching Cubes demo inside its unit box, fSample4 at the
+    // terrain's isovalue inside a box of a few noise features, fSample5 and the terrain graph over a few hills and
+    // tall enough to hold them
+    vSetTime(0.0f);
+    DensityProgram terrainGraph = MakeTerrainGraph();
+    vSetSampleGraph(&terrainGraph);
+    const BenchSource sources[] = {
+        { "fSample1", fSample1, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, 48.0f },
+        { "fSample2", fSample2, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, 48.0f },
+        { "fSample3", fSample3, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, 48.0f },
+        { "fSample4", fSample4, { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f }, 0.0f },
+        { "fSample5", fSample5, { -4.0f, -2.5f, -4.0f }, { 4.0f, 2.5f, 4.0f }, 0.0f },
+        { "fSampleGraph", fSampleGraph, { -4.0f, -2.5f, -4.0f }, { 4.0f, 3.5f, 4.0f }, 0.0f },
+    };
+
+    std::vector<BenchResult> results;
+    for (const BenchSource& source : sources)
+        for (MarchVariant variant : variants)
+            for (int resolution : resolutions)
+                for (int numThreads : threads)
+                {
+                    results.push_back(run(source, variant, resolution, numThreads, repeat, streamBatch, gridNormals));
+                    const BenchResult& r = results.back();
+                    std::fprintf(stderr, "%s %s %d^3 x%d: %.2f ms, %u triangles\n", r.source.c_str(), r.variant,
+                                 r.resolution, r.threads, r.meshMs, r.triangles);
+                }
+
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"mc_bench\",\n");
+    std::printf("  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    std::printf("  \"repeat\": %d,\n", repeat);
+    std::printf("  \"stream_batch_triangles\": %u,\n", streamBatch);
+    std::printf("  \"exact_normals\": %s,\n", gridNormals ? "false" : "true");
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        double cells = (double)r.resolution * r.resolution * r.resolution;
+        double samples = (double)(r.resolution + 3) * (r.resolution + 3) * (r.resolution + 3);
+        std::printf("    {\"source\": \"%s\", \"variant\": \"%s\", \"resolution\": %d, \"threads\": %d, "
+                    "\"vertices\": %u, \"triangles\": %u, \"mesh_ms\": %.3f, \"sample_ms\": %.3f, "
+                    "\"cells_per_s\": %.0f, \"triangles_per_s\": %.0f, \"samples_per_s\": %.0f, \"peak_bytes\": %zu}%s\n",
+                    r.source.c_str(), r.variant, r.resolution, r.threads, r.vertices, r.triangles, r.meshMs, r.sampleMs,
+                    cells / (r.meshMs / 1000.0), r.triangles / (r.meshMs / 1000.0),
+                    r.sampleMs > 0.0 ? samples / (r.sampleMs / 1000.0) : 0.0,
+                    r.peakBytes, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+    std::printf("  \"max_rss_kb\": %ld\n", maxResidentKb());
+    std::printf("}\n");
+    return 0;
+}
@@ -0,0 +1,281 @@
+// noise_bench: times the SimplexNoise functions and prints ns/sample and samples/s as JSON.
+//
+// usage: noise_bench [--samples 262144] [--repeat 5] [--octaves 1,2,3,4,5,6,7,8] [--kernel name] [--check]
+//
+// Every kernel in noiseKernels runs over the same points, laid out two ways:
+//   grid    a lattice with a step of NOISE_GRID_STEP, x fastest, the way terrain sampling walks it
+//   random  uniformly scattered points, so neighbouring samples share no simplex
+// fBm kernels also run at every octave count. A result is the best of --repeat runs.
+// Batched and SIMD forms of the noise plug in as one more entry of noiseKernels.
+// Before timing, checkLattice() makes sure an approximate lattice gives the same values whichever block of it is
+// asked for; --check only runs that and exits with 1 if it fails.
+#include "SimplexNoise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Default benchmark values
+const size_t NOISE_SAMPLES = 64 * 64 * 64;
+const float NOISE_GRID_STEP = 1.0f / 32.0f;     // a few samples per noise feature, like a terrain chunk
+const float NOISE_RANDOM_RANGE = 256.0f;        // random points fall in [-range, range] on each axis
+const SimplexNoise NOISE_FRACTAL(0.8f, 1.0f, 2.0f, 0.5f);   // the settings of fSample4
+const size_t NOISE_CHECK_OCTAVES = 6;
+const float NOISE_CHECK_ERROR = 0.05f;          // the maxError fSample4 asks its lattices for
+const float NOISE_CHECK_TOLERANCE = 1e-5f;      // rounding of the coordinates, which each block works out itself
+
+// The points of one access pattern. x, y and z hold the coordinates of every sample; for the grid pattern,
+// origin, step and size also describe the lattice they lie on
+struct NoisePoints {
+    const char* access;
+    bool grid;
+    std::vector<float> x, y, z;
+    float origin[3];
+    float step;
+    size_t size[3];
+};
+
+// One function under test. run writes its value at the first count points to out; dimensions picks how many
+// of x, y, z it reads. fractal kernels are run at every octave count, the others once with octaves 0.
+// gridOnly kernels only take lattices
+struct NoiseKernel {
+    const char* name;
+    int dimensions;
+    bool fractal;
+    bool gridOnly;
+    void (*run)(const NoisePoints& points, size_t octaves, float* out, size_t count);
+};
+
+static const NoiseKernel noiseKernels[] = {
+    { "noise1", 1, false, false, [](const NoisePoints& p, size_t, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = SimplexNoise::noise(p.x[i]);
+    } },
+    { "noise2", 2, false, false, [](const NoisePoints& p, size_t, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = SimplexNoise::noise(p.x[i], p.y[i]);
+    } },
+    { "noise3", 3, false, false, [](const NoisePoints& p, size_t, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = SimplexNoise::noise(p.x[i], p.y[i], p.z[i]);
+    } },
+    { "noise3_gradient", 3, false, false, [](const NoisePoints& p, size_t, float* out, size_t count) {
+        float gradient[3];
+        for (size_t i = 0; i < count; i++)
+            out[i] = SimplexNoise::noiseGradient(p.x[i], p.y[i], p.z[i], gradient) + gradient[0];
+    } },
+    { "noise3_batch", 3, false, false, [](const NoisePoints& p, size_t, float* out, size_t count) {
+        SimplexNoise::noise(p.x.data(), p.y.data(), p.z.data(), out, count);
+    } },
+    { "fractal1", 1, true, false, [](const NoisePoints& p, size_t octaves, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = NOISE_FRACTAL.fractal(octaves, p.x[i]);
+    } },
+    { "fractal2", 2, true, false, [](const NoisePoints& p, size_t octaves, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = NOISE_FRACTAL.fractal(octaves, p.x[i], p.y[i]);
+    } },
+    { "fractal3", 3, true, false, [](const NoisePoints& p, size_t octaves, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = NOISE_FRACTAL.fractal(octaves, p.x[i], p.y[i], p.z[i]);
+    } },
+    { "fractal3_gradient", 3, true, false, [](const NoisePoints& p, size_t octaves, float* out, size_t count) {
+        float gradient[3];
+        for (size_t i = 0; i < count; i++)
+            out[i] = NOISE_FRACTAL.fractalGradient(octaves, p.x[i], p.y[i], p.z[i], gradient) + gradient[0];
+    } },
+    { "fractal3_batch", 3, true, false, [](const NoisePoints& p, size_t octaves, float* out, size_t count) {
+        NOISE_FRACTAL.fractal(octaves, p.x.data(), p.y.data(), p.z.data(), out, count);
+    } },
+    { "fractal3_lattice", 3, true, true, [](const NoisePoints& p, size_t octaves, float* out, size_t) {
+        NOISE_FRACTAL.fractalLattice(octaves, p.origin[0], p.origin[1], p.origin[2], p.step, p.step, p.step,
+                                     p.size[0], p.size[1], p.size[2], out);
+    } },
+};
+
+// a lattice of about count points with dimensions axes, as close to a cube as count allows
+static NoisePoints makeGrid(size_t count, int dimensions)
+{
+    NoisePoints points;
+    points.access = "grid";
+    points.grid = true;
+    points.origin[0] = 0.1f;
+    points.origin[1] = 0.2f;
+    points.origin[2] = 0.3f;
+    points.step = NOISE_GRID_STEP;
+    size_t side = (size_t)(std::pow((double)count, 1.0 / dimensions) + 0.5);
+    points.size[0] = dimensions == 1 ? count : side;
+    points.size[1] = dimensions >= 2 ? side : 1;
+    points.size[2] = dimensions == 3 ? side : 1;
+    for (size_t k = 0; k < points.size[2]; k++)
+        for (size_t j = 0; j < points.size[1]; j++)
+            for (size_t i = 0; i < points.size[0]; i++)
+            {
+                points.x.push_back(points.origin[0] + i * points.step);
+                points.y.push_back(points.origin[1] + j * points.step);
+                points.z.push_back(points.origin[2] + k * points.step);
+            }
+    return points;
+}
+
+static NoisePoints makeRandom(size_t count)
+{
+    NoisePoints points;
+    points.access = "random";
+    points.grid = false;
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> coordinate(-NOISE_RANDOM_RANGE, NOISE_RANDOM_RANGE);
+    for (size_t i = 0; i < count; i++)
+    {
+        points.x.push_back(coordinate(generator));
+        points.y.push_back(coordinate(generator));
+        points.z.push_back(coordinate(generator));
+    }
+    return points;
+}
+
+static std::vector<int> parseList(const char* text)
+{
+    std::vector<int> values;
+    for (const char* p = text; *p != '\0';)
+    {
+        char* end;
+        long value = std::strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (value > 0)
+            values.push_back((int)value);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+// the largest difference between one plane of an approximate lattice filled in one call and the same plane
+// filled row by row, the rows split in two runs, the way the mesher fills a chunk with and without skipped blocks
+static float checkLattice()
+{
+    const size_t side = 66;
+    const float step = 2.0f / 256.0f;
+    const float origin[3] = { -1.0f - step, 3.0f - step, 0.5f };
+    std::vector<float> plane(side * side), row(side);
+    NOISE_FRACTAL.fractalLattice(NOISE_CHECK_OCTAVES, origin[0], origin[1], origin[2], step, step, step,
+                                 side, side, 1, plane.data(), NOISE_CHECK_ERROR);
+    float largest = 0.0f;
+    for (size_t j = 0; j < side; j++)
+    {
+        const float y = origin[1] + j * step;
+        const size_t split = 1 + j % (side - 1);
+        NOISE_FRACTAL.fractalLattice(NOISE_CHECK_OCTAVES, origin[0], y, origin[2], step, step, step,
+                                     split, 1, 1, row.data(), NOISE_CHECK_ERROR);
+        NOISE_FRACTAL.fractalLattice(NOISE_CHECK_OCTAVES, origin[0] + split * step, y, origin[2], step, step, step,
+                                     side - split, 1, 1, row.data() + split, NOISE_CHECK_ERROR);
+        for (size_t i = 0; i < side; i++)
+            largest = std::max(largest, std::fabs(row[i] - plane[j * side + i]));
+    }
+    return largest;
+}
+
+int main(int argc, char** argv)
+{
+    size_t samples = NOISE_SAMPLES;
+    int repeat = 5;
+    std::vector<int> octaveCounts{ 1, 2, 3, 4, 5, 6, 7, 8 };
+    std::string only;
+    bool checkOnly = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--samples") == 0 && hasValue)
+            samples = (size_t)std::max(std::atol(argv[++i]), 1L);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue)
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--octaves") == 0 && hasValue)
+            octaveCounts = parseList(argv[++i]);
+        else if (std::strcmp(argv[i], "--kernel") == 0 && hasValue)
+            only = argv[++i];
+        else if (std::strcmp(argv[i], "--check") == 0)
+            checkOnly = true;
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--samples 262144] [--repeat 5] [--octaves 1,2,3,4,5,6,7,8] [--kernel name] "
+                         "[--check]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    float latticeMismatch = checkLattice();
+    if (latticeMismatch > NOISE_CHECK_TOLERANCE)
+    {
+        std::fprintf(stderr, "fractalLattice: a plane and its rows differ by %g\n", latticeMismatch);
+        return 1;
+    }
+    if (checkOnly)
+        return 0;
+
+    NoisePoints grids[3] = { makeGrid(samples, 1), makeGrid(samples, 2), makeGrid(samples, 3) };
+    NoisePoints random = makeRandom(samples);
+    // a lattice may round to a few more points than samples
+    size_t largest = samples;
+    for (const NoisePoints& grid : grids)
+        largest = std::max(largest, grid.x.size());
+    std::vector<float> out(largest);
+    float checksum = 0.0f;
+
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"noise_bench\",\n");
+    std::printf("  \"batch_instruction_set\": \"%s\",\n", SimplexNoise::batchInstructionSet());
+    std::printf("  \"repeat\": %d,\n", repeat);
+    std::printf("  \"results\": [\n");
+    bool first = true;
+    for (const NoiseKernel& kernel : noiseKernels)
+    {
+        if (!only.empty() && only != kernel.name)
+            continue;
+        const NoisePoints* patterns[2] = { &grids[kernel.dimensions - 1], &random };
+        for (const NoisePoints* points : patterns)
+        {
+            if (kernel.gridOnly && !points->grid)
+                continue;
+            size_t count = points->x.size();
+            std::vector<size_t> octaves;
+            if (kernel.fractal)
+                octaves.assign(octaveCounts.begin(), octaveCounts.end());
+            else
+                octaves.push_back(0);
+
+            for (size_t octaveCount : octaves)
+            {
+                double best = 1e30;
+                for (int run = 0; run <= repeat; run++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    kernel.run(*points, octaveCount, out.data(), count);
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    // the first run only warms up
+                    if (run > 0)
+                        best = std::min(best, seconds);
+                }
+                checksum += out[count / 2];
+
+                std::printf("%s    {\"kernel\": \"%s\", \"access\": \"%s\", \"octaves\": %zu, \"samples\": %zu, "
+                            "\"ns_per_sample\": %.3f, \"samples_per_s\": %.0f}",
+                            first ? "" : ",\n", kernel.name, points->access, octaveCount, count,
+                            best * 1e9 / count, count / best);
+                std::fflush(stdout);
+                first = false;
+            }
+        }
+    }
+    std::printf("\n  ],\n");
+    // printed so the compiler cannot drop the noise as unused
+    std::printf("  \"checksum\": %g\n", checksum);
+    std::printf("}\n");
+    return 0;
+}
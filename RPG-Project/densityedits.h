@@ -0,0 +1,100 @@
+#ifndef DENSITYEDITS_H
+#define DENSITYEDITS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "marchingcubes.h"
+
+// Default brush values
+const float BRUSH_STRENGTH = 20.0f;  // density change per world unit into the brush
+const float BRUSH_FALLOFF = 0.1f;    // a few cells of the finest chunks
+
+enum class BrushShape {
+    Sphere,
+    Box
+};
+
+enum class BrushMode {
+    Add,        // fills the shape with solid ground (density above 0)
+    Subtract    // digs the shape out
+};
+
+// One edit of the density field: the union with (Add) or the difference from (Subtract) a sphere or box.
+// Inside its shape a brush is a density of Strength per unit of distance from the shape's surface, so
+// max(density, brush) adds it and min(density, -brush) cuts it out. It stops Falloff outside the shape, where
+// it only ever changes the density on the empty side of the surface; Falloff should cover a couple of cells
+// so vertices and normals near the brush read nothing but the brush
+struct DensityBrush {
+    BrushShape Shape{ BrushShape::Sphere };
+    BrushMode Mode{ BrushMode::Add };
+    glm::vec3 Center{ 0.0f };
+    glm::vec3 Extent{ 0.1f };           // radius in x for spheres, half the size along each axis for boxes
+    float Strength{ BRUSH_STRENGTH };
+    float Falloff{ BRUSH_FALLOFF };
+
+    // signed distance from point to the surface of the shape, negative inside
+    float Distance(const glm::vec3& point) const
+    {
+        glm::vec3 offset = point - Center;
+        if (Shape == BrushShape::Sphere)
+            return glm::length(offset) - Extent.x;
+        glm::vec3 outside = glm::abs(offset) - Extent;
+        return glm::length(glm::max(outside, glm::vec3(0.0f))) + std::min(std::max(outside.x, std::max(outside.y, outside.z)), 0.0f);
+    }
+
+    // the box outside of which the brush leaves the density alone
+    void Bounds(glm::vec3& min, glm::vec3& max) const
+    {
+        glm::vec3 reach = (Shape == BrushShape::Sphere ? glm::vec3(Extent.x) : Extent) + Falloff;
+        min = Center - reach;
+        max = Center + reach;
+    }
+
+    float Apply(float density, const glm::vec3& point) const
+    {
+        float distance = Distance(point);
+        if (distance >= Falloff)
+            return density;
+        float brush = -Strength * distance;
+        return Mode == BrushMode::Add ? std::max(density, brush) : std::min(density, -brush);
+    }
+};
+
+// applies brush to the grid points of a MarchingCubesMesher::vSampleGrid() grid that lie inside its bounds,
+// returns whether there were any
+inline bool applyBrush(const DensityBrush& brush, std::vector<GLfloat>& grid, const MarchingCubesMesher& mesher)
+{
+    glm::vec3 min, max;
+    brush.Bounds(min, max);
+    // world position of grid point 0 and the step between grid points
+    glm::vec3 origin(mesher.sMin().fX - mesher.sStep().fX, mesher.sMin().fY - mesher.sStep().fY, mesher.sMin().fZ - mesher.sStep().fZ);
+    glm::vec3 step(mesher.sStep().fX, mesher.sStep().fY, mesher.sStep().fZ);
+    int points = mesher.iGridPoints();
+
+    glm::ivec3 first, last;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        first[axis] = std::max((int)std::ceil((min[axis] - origin[axis]) / step[axis]), 0);
+        last[axis] = std::min((int)std::floor((max[axis] - origin[axis]) / step[axis]), points - 1);
+        if (first[axis] > last[axis])
+            return false;
+    }
+
+    for (int z = first.z; z <= last.z; z++)
+        for (int y = first.y; y <= last.y; y++)
+        {
+            GLfloat* row = &grid[((size_t)z * points + y) * points];
+            for (int x = first.x; x <= last.x; x++)
+            {
+                // the same positions vSampleGrid() samples at
+                glm::vec3 point(mesher.sMin().fX + (x - 1) * step.x, mesher.sMin().fY + (y - 1) * step.y, mesher.sMin().fZ + (z - 1) * step.z);
+                row[x] = brush.Apply(row[x], point);
+            }
+        }
+    return true;
+}
+#endif
@@ -0,0 +1,601 @@
+#ifndef DENSITYGRAPH_H
+#define DENSITYGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <map>
+#include <vector>
+
+#include "SimplexNoise.h"
+
+// Default density graph values
+const int DENSITY_GRAPH_BATCH = 128;    // points a program runs each instruction over before the next one
+const int DENSITY_GRAPH_TEMPS = 4;      // scratch rows the noise instructions scale their coordinates into
+
+// Operation of a density graph node. Densities are positive inside solid and negative in the air, like fSample5,
+// so the primitives below are minus their signed distance, union is max and intersection is min
+enum class DensityOp
+{
+    X, Y, Z,        // the coordinates of the point
+    Constant,       // param[0]
+    Add,            // a + b
+    Sub,            // a - b
+    Mul,            // a * b
+    Min,            // min(a, b)
+    Max,            // max(a, b)
+    MulAdd,         // a * param[0] + param[1]
+    Abs,            // |a|
+    Clamp,          // a clamped to [param[0], param[1]]
+    SmoothMax,      // max(a, b) rounded off where they are closer than param[0]
+    Noise,          // SimplexNoise::noise(a, b, c) of the node's seed at frequency param[0]
+    Fbm,            // SimplexNoise(param[0], 1, param[1], param[2], seed).fractal(octaves, a, b, c)
+    Ridged,         // the same sum over 1 - |noise|, sharp crests where the noise crosses 0
+    Sphere,         // param[3] - |(a, b, c) - param[0..2]|
+    Box             // minus the signed distance from (a, b, c) to the box around param[0..2] with half sizes param[3..5]
+};
+
+struct DensityNode
+{
+    DensityOp op;
+    int a, b, c;            // input nodes, -1 where the op takes fewer
+    int octaves;
+    float param[6];
+    uint32_t seed;          // of the noise ops
+};
+
+// The three coordinate nodes of a (possibly warped) position
+struct DensityPoint
+{
+    int X, Y, Z;
+};
+
+// One step of a compiled program: the op over the registers a, b, c into register out
+struct DensityInstruction
+{
+    DensityOp op;
+    uint16_t out, a, b, c;
+    int octaves;
+    float param[6];
+    uint32_t seed;
+};
+
+// runs op on count points of the rows a, b, c into out, scaling noise coordinates into the temp rows.
+// Every op is a straight loop over the points with no branch on their values, so the loops vectorize
+inline void runDensityOp(const DensityInstruction& step, const float* a, const float* b, const float* c, float* out,
+                         size_t count, float* const* temp)
+{
+    const float* p = step.param;
+    switch (step.op)
+    {
+    case DensityOp::X:
+    case DensityOp::Y:
+    case DensityOp::Z:
+        break;
+    case DensityOp::Constant:
+        std::fill(out, out + count, p[0]);
+        break;
+    case DensityOp::Add:
+        for (size_t n = 0; n < count; n++)
+            out[n] = a[n] + b[n];
+        break;
+    case DensityOp::Sub:
+        for (size_t n = 0; n < count; n++)
+            out[n] = a[n] - b[n];
+        break;
+    case DensityOp::Mul:
+        for (size_t n = 0; n < count; n++)
+            out[n] = a[n] * b[n];
+        break;
+    case DensityOp::Min:
+        for (size_t n = 0; n < count; n++)
+            out[n] = std::min(a[n], b[n]);
+        break;
+    case DensityOp::Max:
+        for (size_t n = 0; n < count; n++)
+            out[n] = std::max(a[n], b[n]);
+        break;
+    case DensityOp::MulAdd:
+        for (size_t n = 0; n < count; n++)
+            out[n] = a[n] * p[0] + p[1];
+        break;
+    case DensityOp::Abs:
+        for (size_t n = 0; n < count; n++)
+            out[n] = std::abs(a[n]);
+        break;
+    case DensityOp::Clamp:
+        for (size_t n = 0; n < count; n++)
+            out[n] = std::min(std::max(a[n], p[0]), p[1]);
+        break;
+    case DensityOp::SmoothMax:
+        for (size_t n = 0; n < count; n++)
+        {
+            float h = std::min(std::max(0.5f + 0.5f * (a[n] - b[n]) / p[0], 0.0f), 1.0f);
+            out[n] = b[n] + (a[n] - b[n]) * h + p[0] * h * (1.0f - h);
+        }
+        break;
+    case DensityOp::Noise:
+        for (size_t n = 0; n < count; n++)
+        {
+            temp[0][n] = a[n] * p[0];
+            temp[1][n] = b[n] * p[0];
+            temp[2][n] = c[n] * p[0];
+        }
+        SimplexNoise::noise(temp[0], temp[1], temp[2], out, count, step.seed);
+        break;
+    case DensityOp::Fbm:
+        SimplexNoise(p[0], 1.0f, p[1], p[2], step.seed).fractal(step.octaves, a, b, c, out, count);
+        break;
+    case DensityOp::Ridged:
+    {
+        std::fill(out, out + count, 0.0f);
+        float frequency = p[0];
+        float amplitude = 1.0f;
+        float denom = 0.0f;
+        for (int octave = 0; octave < step.octaves; octave++)
+        {
+            for (size_t n = 0; n < count; n++)
+            {
+                temp[0][n] = a[n] * frequency;
+                temp[1][n] = b[n] * frequency;
+                temp[2][n] = c[n] * frequency;
+            }
+            SimplexNoise::noise(temp[0], temp[1], temp[2], temp[3], count, step.seed);
+            for (size_t n = 0; n < count; n++)
+                out[n] += amplitude * (1.0f - std::abs(temp[3][n]));
+            denom += amplitude;
+            frequency *= p[1];
+            amplitude *= p[2];
+        }
+        for (size_t n = 0; n < count; n++)
+            out[n] /= denom;
+        break;
+    }
+    case DensityOp::Sphere:
+        for (size_t n = 0; n < count; n++)
+        {
+            float dx = a[n] - p[0], dy = b[n] - p[1], dz = c[n] - p[2];
+            out[n] = p[3] - std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+        break;
+    case DensityOp::Box:
+        for (size_t n = 0; n < count; n++)
+        {
+            float qx = std::abs(a[n] - p[0]) - p[3];
+            float qy = std::abs(b[n] - p[1]) - p[4];
+            float qz = std::abs(c[n] - p[2]) - p[5];
+            float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f), oz = std::max(qz, 0.0f);
+            float inside = std::min(std::max(qx, std::max(qy, qz)), 0.0f);
+            out[n] = -(std::sqrt(ox * ox + oy * oy + oz * oz) + inside);
+        }
+        break;
+    }
+}
+
+// A density graph compiled by DensityGraph::Compile() into a flat list of instructions over rows of
+// DENSITY_GRAPH_BATCH points. Registers 0, 1 and 2 are the x, y and z of the points, the rest are rows of scratch.
+// The instructions run one after another over a whole batch, so choosing an op costs once per batch rather than
+// once per point. A program is read only once compiled and may be evaluated from any number of threads
+class DensityProgram
+{
+public:
+    // out[n] = density at (x[n], y[n], z[n]) for n < count
+    void Evaluate(const float* x, const float* y, const float* z, float* out, size_t count) const
+    {
+        for (size_t first = 0; first < count; first += DENSITY_GRAPH_BATCH)
+        {
+            size_t size = std::min((size_t)DENSITY_GRAPH_BATCH, count - first);
+            runBatch(x + first, y + first, z + first, out + first, size);
+        }
+    }
+
+    float Evaluate(float x, float y, float z) const
+    {
+        float out;
+        runBatch(&x, &y, &z, &out, 1);
+        return out;
+    }
+
+    // the nx * ny * nz lattice (x + i * dx, y + j * dy, z + k * dz), x fastest in out. Batches run on across rows,
+    // so short rows still fill them
+    void Lattice(float x, float y, float z, float dx, float dy, float dz, size_t nx, size_t ny, size_t nz, float* out) const
+    {
+        float xs[DENSITY_GRAPH_BATCH], ys[DENSITY_GRAPH_BATCH], zs[DENSITY_GRAPH_BATCH];
+        size_t count = nx * ny * nz;
+        size_t i = 0, j = 0, k = 0;
+        for (size_t first = 0; first < count; first += DENSITY_GRAPH_BATCH)
+        {
+            size_t size = std::min((size_t)DENSITY_GRAPH_BATCH, count - first);
+            for (size_t n = 0; n < size; n++)
+            {
+                xs[n] = x + i * dx;
+                ys[n] = y + j * dy;
+                zs[n] = z + k * dz;
+                if (++i == nx)
+                {
+                    i = 0;
+                    if (++j == ny)
+                    {
+                        j = 0;
+                        k++;
+                    }
+                }
+            }
+            runBatch(xs, ys, zs, out + first, size);
+        }
+    }
+
+    size_t Instructions() const
+    {
+        return code.size();
+    }
+
+    int Registers() const
+    {
+        return registers;
+    }
+
+    // 64 bit FNV-1a hash of the instructions, equal for programs that compute the same thing the same way
+    uint64_t Hash() const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t size) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t n = 0; n < size; n++)
+                hash = (hash ^ bytes[n]) * 1099511628211ull;
+        };
+        for (const DensityInstruction& step : code)
+        {
+            int op = (int)step.op;
+            mix(&op, sizeof(op));
+            mix(&step.out, sizeof(step.out));
+            mix(&step.a, sizeof(step.a));
+            mix(&step.b, sizeof(step.b));
+            mix(&step.c, sizeof(step.c));
+            mix(&step.octaves, sizeof(step.octaves));
+            mix(step.param, sizeof(step.param));
+            mix(&step.seed, sizeof(step.seed));
+        }
+        mix(&result, sizeof(result));
+        return hash;
+    }
+
+private:
+    friend class DensityGraph;
+
+    std::vector<DensityInstruction> code;
+    int registers{ 3 };     // x, y, z and the scratch rows
+    int result{ -1 };       // register holding the density once the code has run, -1 for an empty program
+
+    void runBatch(const float* x, const float* y, const float* z, float* out, size_t count) const
+    {
+        if (result < 0)
+        {
+            std::fill(out, out + count, 0.0f);
+            return;
+        }
+        // rows of this thread's scratch: registers - 3 of them, then the temps
+        static thread_local std::vector<float> scratch;
+        size_t rows = (size_t)(registers - 3 + DENSITY_GRAPH_TEMPS);
+        if (scratch.size() < rows * DENSITY_GRAPH_BATCH)
+            scratch.resize(rows * DENSITY_GRAPH_BATCH);
+        auto row = [&](int r) -> float* {
+            return scratch.data() + (size_t)(r - 3) * DENSITY_GRAPH_BATCH;
+        };
+        const float* inputs[3] = { x, y, z };
+        auto read = [&](int r) -> const float* {
+            return r < 3 ? inputs[r] : row(r);
+        };
+        float* temp[DENSITY_GRAPH_TEMPS];
+        for (int t = 0; t < DENSITY_GRAPH_TEMPS; t++)
+            temp[t] = row(registers + t);
+
+        for (const DensityInstruction& step : code)
+            runDensityOp(step, read(step.a), read(step.b), read(step.c), row(step.out), count, temp);
+        std::copy(read(result), read(result) + count, out);
+    }
+};
+
+// Declarative description of a density: nodes are added with the functions below, each returning the index of
+// its node, and Compile() turns the node an output was built from into a DensityProgram.
+// Compile() folds constants, merges nodes that compute the same thing, drops what the output does not use and
+// gives each value a register only while it is still needed
+class DensityGraph
+{
+public:
+    // the noise nodes of the graph are of seed, each seed another density of the same kind
+    explicit DensityGraph(uint32_t seed = 0) : seed(seed) {}
+
+    int X() { return add(DensityOp::X); }
+    int Y() { return add(DensityOp::Y); }
+    int Z() { return add(DensityOp::Z); }
+    DensityPoint Position() { return { X(), Y(), Z() }; }
+    int Constant(float value) { return add(DensityOp::Constant, -1, -1, -1, 0, { value }); }
+
+    int Add(int a, int b) { return add(DensityOp::Add, a, b); }
+    int Sub(int a, int b) { return add(DensityOp::Sub, a, b); }
+    int Mul(int a, int b) { return add(DensityOp::Mul, a, b); }
+    int Min(int a, int b) { return add(DensityOp::Min, a, b); }
+    int Max(int a, int b) { return add(DensityOp::Max, a, b); }
+    int MulAdd(int a, float scale, float offset) { return add(DensityOp::MulAdd, a, -1, -1, 0, { scale, offset }); }
+    int Scale(int a, float scale) { return MulAdd(a, scale, 0.0f); }
+    int Offset(int a, float offset) { return MulAdd(a, 1.0f, offset); }
+    int Negate(int a) { return MulAdd(a, -1.0f, 0.0f); }
+    int Abs(int a) { return add(DensityOp::Abs, a); }
+    int Clamp(int a, float low, float high) { return add(DensityOp::Clamp, a, -1, -1, 0, { low, high }); }
+
+    // noise of the position p
+    int Noise(DensityPoint p, float frequency)
+    {
+        return add(DensityOp::Noise, p.X, p.Y, p.Z, 0, { frequency });
+    }
+
+    int Fbm(DensityPoint p, int octaves, float frequency, float lacunarity = 2.0f, float persistence = 0.5f)
+    {
+        return add(DensityOp::Fbm, p.X, p.Y, p.Z, octaves, { frequency, lacunarity, persistence });
+    }
+
+    int Ridged(DensityPoint p, int octaves, float frequency, float lacunarity = 2.0f, float persistence = 0.5f)
+    {
+        return add(DensityOp::Ridged, p.X, p.Y, p.Z, octaves, { frequency, lacunarity, persistence });
+    }
+
+    // p moved by up to strength along each axis by three fBms of it, offset from each other so they differ
+    DensityPoint Warp(DensityPoint p, float strength, int octaves, float frequency)
+    {
+        int warp[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float shift = 31.7f * (axis + 1);
+            DensityPoint moved = { Offset(p.X, shift), Offset(p.Y, -shift), Offset(p.Z, 0.5f * shift) };
+            warp[axis] = Scale(Fbm(moved, octaves, frequency), strength);
+        }
+        return { Add(p.X, warp[0]), Add(p.Y, warp[1]), Add(p.Z, warp[2]) };
+    }
+
+    // solid below the plane through the points q with n . q = distance
+    int Plane(DensityPoint p, float nx, float ny, float nz, float distance)
+    {
+        return Offset(Add(Add(Scale(p.X, -nx), Scale(p.Y, -ny)), Scale(p.Z, -nz)), distance);
+    }
+
+    int Sphere(DensityPoint p, float cx, float cy, float cz, float radius)
+    {
+        return add(DensityOp::Sphere, p.X, p.Y, p.Z, 0, { cx, cy, cz, radius });
+    }
+
+    int Box(DensityPoint p, float cx, float cy, float cz, float hx, float hy, float hz)
+    {
+        return add(DensityOp::Box, p.X, p.Y, p.Z, 0, { cx, cy, cz, hx, hy, hz });
+    }
+
+    // constructive solid geometry
+    int Union(int a, int b) { return Max(a, b); }
+    int Intersect(int a, int b) { return Min(a, b); }
+    int Subtract(int a, int b) { return Min(a, Negate(b)); }
+    int SmoothUnion(int a, int b, float radius) { return add(DensityOp::SmoothMax, a, b, -1, 0, { radius }); }
+
+    const std::vector<DensityNode>& Nodes() const
+    {
+        return nodes;
+    }
+
+    DensityProgram Compile(int output) const
+    {
+        // fold and merge, in node order: every node only refers to nodes added before it
+        std::vector<DensityNode> folded;
+        std::vector<int> remap(nodes.size(), -1);
+        std::map<std::vector<uint32_t>, int> seen;
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            DensityNode node = nodes[n];
+            node.a = node.a >= 0 ? remap[node.a] : -1;
+            node.b = node.b >= 0 ? remap[node.b] : -1;
+            node.c = node.c >= 0 ? remap[node.c] : -1;
+            int same = simplify(folded, node);
+            if (same < 0)
+            {
+                std::vector<uint32_t> key = keyOf(node);
+                auto found = seen.find(key);
+                if (found == seen.end())
+                {
+                    same = (int)folded.size();
+                    folded.push_back(node);
+                    seen.emplace(key, same);
+                }
+                else
+                    same = found->second;
+            }
+            remap[n] = same;
+        }
+
+        DensityProgram program;
+        if (output < 0 || output >= (int)nodes.size())
+            return program;
+        int root = remap[output];
+
+        // the nodes root is built from, and the last node that reads each of them
+        std::vector<bool> live(folded.size(), false);
+        std::vector<int> lastUse(folded.size(), -1);
+        live[root] = true;
+        for (int n = root; n >= 0; n--)
+        {
+            if (!live[n])
+                continue;
+            for (int input : { folded[n].a, folded[n].b, folded[n].c })
+            {
+                if (input >= 0)
+                {
+                    live[input] = true;
+                    lastUse[input] = std::max(lastUse[input], n);
+                }
+            }
+        }
+        lastUse[root] = (int)folded.size();
+
+        // registers: the coordinates stay in 0..2, everything else takes a free scratch row while it is live
+        std::vector<int> reg(folded.size(), -1);
+        std::vector<int> freeRows;
+        int registers = 3;
+        auto allocate = [&]() {
+            if (freeRows.empty())
+                return registers++;
+            int r = freeRows.back();
+            freeRows.pop_back();
+            return r;
+        };
+        auto release = [&](int n) {
+            for (int input : { folded[n].a, folded[n].b, folded[n].c })
+            {
+                if (input >= 0 && lastUse[input] == n && reg[input] >= 3)
+                {
+                    freeRows.push_back(reg[input]);
+                    lastUse[input] = -1;    // an input read twice by n is only freed once
+                }
+            }
+        };
+        for (int n = 0; n <= root; n++)
+        {
+            if (!live[n])
+                continue;
+            const DensityNode& node = folded[n];
+            if (node.op == DensityOp::X || node.op == DensityOp::Y || node.op == DensityOp::Z)
+            {
+                reg[n] = node.op == DensityOp::X ? 0 : node.op == DensityOp::Y ? 1 : 2;
+                continue;
+            }
+            // a point by point op may write over an input it is done with; the noise ops still read their
+            // coordinates while they write, so they take a row of their own
+            bool pointwise = node.op != DensityOp::Fbm && node.op != DensityOp::Ridged;
+            if (pointwise)
+                release(n);
+            reg[n] = allocate();
+            if (!pointwise)
+                release(n);
+
+            DensityInstruction step;
+            step.op = node.op;
+            step.out = (uint16_t)reg[n];
+            step.a = (uint16_t)(node.a >= 0 ? reg[node.a] : reg[n]);
+            step.b = (uint16_t)(node.b >= 0 ? reg[node.b] : reg[n]);
+            step.c = (uint16_t)(node.c >= 0 ? reg[node.c] : reg[n]);
+            step.octaves = node.octaves;
+            std::copy(node.param, node.param + 6, step.param);
+            step.seed = node.seed;
+            program.code.push_back(step);
+        }
+        program.registers = registers;
+        program.result = reg[root];
+        return program;
+    }
+
+private:
+    std::vector<DensityNode> nodes;
+    uint32_t seed;
+
+    int add(DensityOp op, int a = -1, int b = -1, int c = -1, int octaves = 0, std::initializer_list<float> param = {})
+    {
+        DensityNode node;
+        node.op = op;
+        node.a = a;
+        node.b = b;
+        node.c = c;
+        node.octaves = octaves;
+        std::fill(node.param, node.param + 6, 0.0f);
+        std::copy(param.begin(), param.end(), node.param);
+        node.seed = op == DensityOp::Noise || op == DensityOp::Fbm || op == DensityOp::Ridged ? seed : 0;
+        nodes.push_back(node);
+        return (int)nodes.size() - 1;
+    }
+
+    static std::vector<uint32_t> keyOf(const DensityNode& node)
+    {
+        std::vector<uint32_t> key = { (uint32_t)node.op, (uint32_t)node.a, (uint32_t)node.b, (uint32_t)node.c,
+                                      (uint32_t)node.octaves, node.seed };
+        for (float value : node.param)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            key.push_back(bits);
+        }
+        return key;
+    }
+
+    static bool isConstant(const std::vector<DensityNode>& folded, int n, float& value)
+    {
+        if (n < 0 || folded[n].op != DensityOp::Constant)
+            return false;
+        value = folded[n].param[0];
+        return true;
+    }
+
+    // rewrites node into a cheaper equivalent over folded, or returns the folded node it equals (-1 if none)
+    static int simplify(const std::vector<DensityNode>& folded, DensityNode& node)
+    {
+        if (node.op == DensityOp::X || node.op == DensityOp::Y || node.op == DensityOp::Z || node.op == DensityOp::Constant)
+            return -1;
+
+        // every input constant: run the op once and keep the value
+        float ka = 0.0f, kb = 0.0f, kc = 0.0f;
+        bool constA = isConstant(folded, node.a, ka), constB = isConstant(folded, node.b, kb);
+        bool constC = isConstant(folded, node.c, kc);
+        if ((node.a < 0 || constA) && (node.b < 0 || constB) && (node.c < 0 || constC))
+        {
+            DensityInstruction step;
+            step.op = node.op;
+            step.octaves = node.octaves;
+            std::copy(node.param, node.param + 6, step.param);
+            step.seed = node.seed;
+            float temps[DENSITY_GRAPH_TEMPS];
+            float* temp[DENSITY_GRAPH_TEMPS] = { &temps[0], &temps[1], &temps[2], &temps[3] };
+            float value;
+            runDensityOp(step, &ka, &kb, &kc, &value, 1, temp);
+            node = DensityNode{ DensityOp::Constant, -1, -1, -1, 0, { value }, 0 };
+            return -1;
+        }
+
+        // a constant operand of + - * becomes a MulAdd, and MulAdds of MulAdds become one
+        if (node.op == DensityOp::Add && (constA || constB))
+            node = DensityNode{ DensityOp::MulAdd, constA ? node.b : node.a, -1, -1, 0, { 1.0f, constA ? ka : kb }, 0 };
+        else if (node.op == DensityOp::Sub && constB)
+            node = DensityNode{ DensityOp::MulAdd, node.a, -1, -1, 0, { 1.0f, -kb }, 0 };
+        else if (node.op == DensityOp::Sub && constA)
+            node = DensityNode{ DensityOp::MulAdd, node.b, -1, -1, 0, { -1.0f, ka }, 0 };
+        else if (node.op == DensityOp::Mul && (constA || constB))
+            node = DensityNode{ DensityOp::MulAdd, constA ? node.b : node.a, -1, -1, 0, { constA ? ka : kb, 0.0f }, 0 };
+        if (node.op != DensityOp::MulAdd)
+            return -1;
+        const DensityNode& input = folded[node.a];
+        if (input.op == DensityOp::MulAdd)
+        {
+            float scale = input.param[0] * node.param[0];
+            float offset = input.param[1] * node.param[0] + node.param[1];
+            node = DensityNode{ DensityOp::MulAdd, input.a, -1, -1, 0, { scale, offset }, 0 };
+        }
+        if (node.param[0] == 0.0f)
+            node = DensityNode{ DensityOp::Constant, -1, -1, -1, 0, { node.param[1] }, 0 };
+        else if (node.param[0] == 1.0f && node.param[1] == 0.0f)
+            return node.a;
+        return -1;
+    }
+};
+
+// The graph F7 switches to after fSample5: warped rolling hills with ridges on top, hollowed by thin caves,
+// with a floating rock blended into the sky above the origin
+inline DensityProgram MakeTerrainGraph(uint32_t seed = 0)
+{
+    DensityGraph graph(seed);
+    DensityPoint p = graph.Position();
+    DensityPoint warped = graph.Warp(p, 0.3f, 2, 0.5f);
+    DensityPoint ground = { warped.X, graph.Constant(0.0f), warped.Z };
+    int hills = graph.Scale(graph.Fbm(ground, 5, 0.25f), 1.5f);
+    int ridges = graph.Scale(graph.Ridged(ground, 4, 0.4f), 0.8f);
+    int terrain = graph.Sub(graph.Add(hills, ridges), p.Y);
+    int caves = graph.MulAdd(graph.Abs(graph.Noise(warped, 1.2f)), -1.0f, 0.06f);
+    terrain = graph.Subtract(terrain, caves);
+    int rock = graph.Union(graph.Sphere(p, 0.0f, 2.5f, 0.0f, 0.6f), graph.Box(p, 0.0f, 2.0f, 0.0f, 0.3f, 0.6f, 0.3f));
+    return graph.Compile(graph.SmoothUnion(terrain, rock, 0.3f));
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded multi-producer/multi-consumer queue without locks (Dmitry Vyukov's ring buffer).
+// Every slot carries a sequence number that says whether it is free for the producer of a given
+// position or holds the value for the consumer of that position, so TryPush and TryPop only need
+// one compare-and-swap on the shared position counter.
+template <typename T>
+class LockFreeQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit LockFreeQueue(size_t capacity = 256)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        slots = std::vector<Slot>(size);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    // returns false if the queue is full
+    bool TryPush(const T& value)
+    {
+        size_t position = pushPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+            if (difference == 0)
+            {
+                if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    // returns false if the queue is empty
+    bool TryPop(T& value)
+    {
+        size_t position = popPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+            if (difference == 0)
+            {
+                if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = slot.value;
+                    slot.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = popPosition.load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Slot() : sequence(0), value() {}
+        Slot(const Slot&) : sequence(0), value() {}
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    // kept on separate cache lines so producers and consumers do not fight over one line
+    alignas(64) std::atomic<size_t> pushPosition{ 0 };
+    alignas(64) std::atomic<size_t> popPosition{ 0 };
+};
+#endif
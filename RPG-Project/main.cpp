@@ -12,6 +12,9 @@
 #include "model.h"
 #include "mesh.h"
 #include "marchingcubes.h"
+#include "terrain.h"
+#include "animatedsurface.h"
+#include "densitygraph.h"
 
 // forward declaration 
 void processInput(GLFWwindow* window);
@@ -42,6 +45,15 @@ float lastFrame{ 0.0f };
 
 bool flyMode{};     // enables camera movement
 bool flashlight{};
+MarchVariant marchVariant{ MARCH_CUBES };   // F6 switches the terrain between marching cubes and tetrahedra
+bool animateSurface{};      // F5 swaps the terrain for the selected density meshed again every frame
+unsigned int worldSeed{ 0 };    // the noise fSample4, fSample5 and the terrain graph are made of; another seed, another world
+
+// terrain editing: left click digs, shift + left click places, B switches between sphere and box brushes
+bool editRequested{};
+BrushMode editMode{ BrushMode::Subtract };
+BrushShape editShape{ BrushShape::Sphere };
+const float EDIT_DISTANCE = 0.5f;   // how far in front of the camera the brush is centered
 
 glm::mat4 projection = glm::mat4{ 1.0f };
 
@@ -155,8 +167,6 @@ int main()
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    GLuint terrainVBO, terrainVAO;
-
     Shader shaderDiffuse("shaders/diffuse.vert", "shaders/diffuse.frag");
     Shader shaderUnlit("shaders/unlit.vert", "shaders/unlit.frag");
 
@@ -174,8 +184,12 @@ int main()
     shaderDiffuse.setInt("material.specular", 1);
 
     vSetTime(0.0f);
-    GLuint terrainNumOfTris{ 0 };
-    vMarchingCubes(&terrainVBO, &terrainVAO, &terrainNumOfTris);
+    vSetSeed(worldSeed);
+    DensityProgram terrainGraph = MakeTerrainGraph(worldSeed);
+    vSetSampleGraph(&terrainGraph);
+    ChunkManager terrain(fSample);
+    AnimatedSurface animatedSurface;
+    bool terrainPaused{};
 
     while (!glfwWindowShouldClose(window))
     {
@@ -236,15 +250,51 @@ int main()
         shaderDiffuse.setMat4("model", model);
         // placeholderModel.Draw(shaderDiffuse);
         
+        // terrain chunks are meshed in world space
         model = glm::mat4(1.0f);      // identity matrix
-        model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.0f));
         shaderDiffuse.setMat4("model", model);
 
-        // vSetTime(currentFrame * 0.25f);
-        // vMarchingCubes();
-        glBindVertexArray(terrainVAO);
-        glDrawArrays(GL_TRIANGLES, 0, terrainNumOfTris * 3);
+        if (animateSurface)
+        {
+            // the terrain is left alone while the time moves; fSample4, fSample5 and the graph do not move and have
+            // their surface at 0
+            if (!terrainPaused)
+            {
+                // the chunk workers read the time, so none may still be meshing once it moves
+                terrain.Clear();
+                terrain.WaitIdle();
+                terrainPaused = true;
+            }
+            bool stillSource = fSample == fSample4 || fSample == fSample5 || fSample == fSampleGraph;
+            animatedSurface.TargetValue = stillSource ? 0.0f : ANIMATED_TARGET;
+            animatedSurface.Variant = marchVariant;
+            animatedSurface.Update(fSample, currentFrame * ANIMATED_TIME_SCALE);
+            animatedSurface.Draw();
+        }
+        else
+        {
+            if (terrainPaused)
+            {
+                // chunks meshed while the time moved are made again at time 0
+                vSetTime(0.0f);
+                terrain.Clear();
+                animatedSurface.Clear();
+                terrainPaused = false;
+            }
+            terrain.SetDensity(fSample);
+            terrain.SetVariant(marchVariant);
+            if (editRequested)
+            {
+                DensityBrush brush;
+                brush.Shape = editShape;
+                brush.Mode = editMode;
+                brush.Center = camera.Position + camera.Front * EDIT_DISTANCE;
+                terrain.Edit(brush);
+                editRequested = false;
+            }
+            terrain.Update(camera.Position);
+            terrain.Draw();
+        }
 
         glBindVertexArray(cubeVAO);
         shaderUnlit.use();
@@ -267,8 +317,8 @@ int main()
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteBuffers(1, &cubeVBO);
 
-    glDeleteVertexArrays(1, &terrainVAO);
-    glDeleteBuffers(1, &terrainVBO);
+    terrain.Clear();
+    animatedSurface.Clear();
 
     glfwTerminate();
     return 0;
@@ -338,12 +388,35 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		{
 			fSample = fSample4;
 		}
+        else if (fSample == fSample4)
+        {
+            fSample = fSample5;
+        }
+        else if (fSample == fSample5)
+        {
+            fSample = fSampleGraph;
+        }
         else
         {
             fSample = fSample1;
         }
     }
 
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+    {
+        animateSurface = !animateSurface;
+    }
+
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+    {
+        marchVariant = marchVariant == MARCH_CUBES ? MARCH_TETRAHEDRA : MARCH_CUBES;
+    }
+
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        editShape = editShape == BrushShape::Sphere ? BrushShape::Box : BrushShape::Sphere;
+    }
+
     // placeholder -----
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
@@ -378,6 +451,11 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        editRequested = true;
+        editMode = (mods & GLFW_MOD_SHIFT) ? BrushMode::Add : BrushMode::Subtract;
+    }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
     {
         flyMode = true;
@@ -16,24 +16,14 @@
 
 #include "stdio.h"
 #include "math.h"
+#include <algorithm>
 #include <vector>
-//This program requires the OpenGL and GLUT libraries
-// You can obtain them for free from http://www.opengl.org
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 
 #include "SimplexNoise.h"
-
-struct GLvector
-{
-        GLfloat fX;
-        GLfloat fY;
-        GLfloat fZ;     
-};
+#include "densitygraph.h"
 
 //These tables are used so that everything can be done in little loops that you can look at all at once
 // rather than in pages and pages of unrolled code.
@@ -61,6 +51,25 @@ static const GLfloat a2fEdgeDirection[12][3] =
         {0.0, 0.0, 1.0},{0.0, 0.0, 1.0},{ 0.0, 0.0, 1.0},{0.0,  0.0, 1.0}
 };
 
+//a2iEdgeLatticeKey lists, for each of the 12 edges of the cube, the endpoint vertex with the lower
+// coordinates, the other endpoint and the axis (0 = x, 1 = y, 2 = z) the edge runs along.
+// Neighbouring cubes name a shared edge by the same lower lattice point and axis, which lets them share its vertex
+static const GLint a2iEdgeLatticeKey[12][3] =
+{
+        {0,1,0}, {1,2,1}, {3,2,0}, {0,3,1},
+        {4,5,0}, {5,6,1}, {7,6,0}, {4,7,1},
+        {0,4,2}, {1,5,2}, {2,6,2}, {3,7,2}
+};
+
+//a2iLatticeStep lists the lattice edges that start at a lattice point as the step to their other end.
+// Marching Cubes only cuts the first 3, the axes. The six tetrahedrons of a cube also cut the diagonals
+// of its faces and its body, which all run from a lower to a higher lattice point in the same way
+static const GLint a2iLatticeStep[7][3] =
+{
+        {1,0,0}, {0,1,0}, {0,0,1},
+        {1,1,0}, {1,0,1}, {0,1,1}, {1,1,1}
+};
+
 //a2iTetrahedronEdgeConnection lists the index of the endpoint vertices for each of the 6 edges of the tetrahedron
 static const GLint a2iTetrahedronEdgeConnection[6][2] =
 {
@@ -79,6 +88,18 @@ static const GLint a2iTetrahedronsInACube[6][4] =
         {0,4,5,6},
 };
 
+//a2iTetrahedronEdgeLatticeKey lists, for each edge of each of the six tetrahedrons within the cube, the
+// endpoint vertex of the cube with the lower coordinates and the a2iLatticeStep the edge runs along
+static const GLint a2iTetrahedronEdgeLatticeKey[6][6][2] =
+{
+        {{0,4}, {1,2}, {0,0}, {0,6}, {5,1}, {1,5}},
+        {{0,0}, {1,1}, {0,3}, {0,6}, {1,5}, {2,2}},
+        {{0,3}, {3,0}, {0,1}, {0,6}, {2,2}, {3,4}},
+        {{0,1}, {3,2}, {0,5}, {0,6}, {3,4}, {7,0}},
+        {{0,5}, {4,1}, {0,2}, {0,6}, {7,0}, {4,3}},
+        {{0,2}, {4,0}, {0,4}, {0,6}, {4,3}, {5,1}},
+};
+
 static const GLfloat afAmbientWhite [] = {0.25, 0.25, 0.25, 1.00}; 
 static const GLfloat afAmbientRed   [] = {0.25, 0.00, 0.00, 1.00}; 
 static const GLfloat afAmbientGreen [] = {0.00, 0.25, 0.00, 1.00}; 
@@ -92,22 +113,15 @@ static const GLfloat afSpecularRed  [] = {1.00, 0.25, 0.25, 1.00};
 static const GLfloat afSpecularGreen[] = {0.25, 1.00, 0.25, 1.00}; 
 static const GLfloat afSpecularBlue [] = {0.25, 0.25, 1.00, 1.00}; 
 
+//cells along each axis of the blocks that empty space skipping accepts or rejects as a whole
+static const GLint iSkipBlockCells = 4;
+
 
-GLenum    ePolygonMode = GL_FILL;
-GLint     iDataSetSize = 32;    // resolution
-GLfloat   fStepSize = 1.0/iDataSetSize; 
-GLfloat   fTargetValue = 0.0;
 GLfloat   fTime = 0.0;
 GLvector  sSourcePoint[3];
-GLboolean bSpin = true;
-GLboolean bMove = true;
-GLboolean bLight = true;
-
-GLfloat (*fSample)(GLfloat fX, GLfloat fY, GLfloat fZ) = fSample4;
-GLvoid (*vMarchCube)(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale) = vMarchCube1;
+GLuint    iSeed = 0;
 
-GLfloat vertices[491520]{};
-GLint numOfTris{0};
+DensityFunction fSample = fSample4;
 
 
 //fGetOffset finds the approximate point of intersection of the surface
@@ -182,139 +196,539 @@ GLvoid vSetTime(GLfloat fNewTime)
         sSourcePoint[2].fZ *= fOffset;
 }
 
-//fSample1 finds the distance of (fX, fY, fZ) from three moving points
-GLfloat fSample1(GLfloat fX, GLfloat fY, GLfloat fZ)
+//fSample1..3 are written as functors, so vSampleLatticeOf can be compiled for each of them with the density
+// inlined into its loop. A functor copies fTime and the moving points when it is made, which keeps them in
+// registers while the loop writes its results
+
+//Sample1Density finds the distance of (fX, fY, fZ) from three moving points
+struct Sample1Density
 {
-        GLfloat fResult = 0.0f;
-        GLfloat fDx, fDy, fDz;
-        fDx = fX - sSourcePoint[0].fX;
-        fDy = fY - sSourcePoint[0].fY;
-        fDz = fZ - sSourcePoint[0].fZ;
-        fResult += 0.5f/(fDx*fDx + fDy*fDy + fDz*fDz);
+        GLvector asSource[3];
 
-        fDx = fX - sSourcePoint[1].fX;
-        fDy = fY - sSourcePoint[1].fY;
-        fDz = fZ - sSourcePoint[1].fZ;
-        fResult += 1.0f/(fDx*fDx + fDy*fDy + fDz*fDz);
+        Sample1Density()
+        {
+                asSource[0] = sSourcePoint[0];
+                asSource[1] = sSourcePoint[1];
+                asSource[2] = sSourcePoint[2];
+        }
 
-        fDx = fX - sSourcePoint[2].fX;
-        fDy = fY - sSourcePoint[2].fY;
-        fDz = fZ - sSourcePoint[2].fZ;
-        fResult += 1.5f/(fDx*fDx + fDy*fDy + fDz*fDz);
+        GLfloat operator()(GLfloat fX, GLfloat fY, GLfloat fZ) const
+        {
+                GLfloat fResult = 0.0f;
+                GLfloat fDx, fDy, fDz;
+                fDx = fX - asSource[0].fX;
+                fDy = fY - asSource[0].fY;
+                fDz = fZ - asSource[0].fZ;
+                fResult += 0.5f/(fDx*fDx + fDy*fDy + fDz*fDz);
+
+                fDx = fX - asSource[1].fX;
+                fDy = fY - asSource[1].fY;
+                fDz = fZ - asSource[1].fZ;
+                fResult += 1.0f/(fDx*fDx + fDy*fDy + fDz*fDz);
+
+                fDx = fX - asSource[2].fX;
+                fDy = fY - asSource[2].fY;
+                fDz = fZ - asSource[2].fZ;
+                fResult += 1.5f/(fDx*fDx + fDy*fDy + fDz*fDz);
+
+                return fResult;
+        }
+};
 
-        return fResult;
-}
+//Sample2Density finds the distance of (fX, fY, fZ) from three moving lines
+struct Sample2Density
+{
+        GLvector asSource[3];
 
-//fSample2 finds the distance of (fX, fY, fZ) from three moving lines
-GLfloat fSample2(GLfloat fX, GLfloat fY, GLfloat fZ)
+        Sample2Density()
+        {
+                asSource[0] = sSourcePoint[0];
+                asSource[1] = sSourcePoint[1];
+                asSource[2] = sSourcePoint[2];
+        }
+
+        GLfloat operator()(GLfloat fX, GLfloat fY, GLfloat fZ) const
+        {
+                GLdouble fResult = 0.0;
+                GLdouble fDx, fDy, fDz;
+                fDx = fX - asSource[0].fX;
+                fDy = fY - asSource[0].fY;
+                fResult += 0.5/(fDx*fDx + fDy*fDy);
+
+                fDx = fX - asSource[1].fX;
+                fDz = fZ - asSource[1].fZ;
+                fResult += 0.75/(fDx*fDx + fDz*fDz);
+
+                fDy = fY - asSource[2].fY;
+                fDz = fZ - asSource[2].fZ;
+                fResult += 1.0/(fDy*fDy + fDz*fDz);
+
+                return fResult;
+        }
+};
+
+//Sample3Density defines a height field by plugging the distance from the center into the sin and cos functions
+struct Sample3Density
 {
-        GLdouble fResult = 0.0;
-        GLdouble fDx, fDy, fDz;
-        fDx = fX - sSourcePoint[0].fX;
-        fDy = fY - sSourcePoint[0].fY;
-        fResult += 0.5/(fDx*fDx + fDy*fDy);
+        GLfloat fSourceTime;
 
-        fDx = fX - sSourcePoint[1].fX;
-        fDz = fZ - sSourcePoint[1].fZ;
-        fResult += 0.75/(fDx*fDx + fDz*fDz);
+        Sample3Density() : fSourceTime(fTime) {}
+
+        GLfloat operator()(GLfloat fX, GLfloat fY, GLfloat fZ) const
+        {
+                GLfloat fHeight = 20.0*(fSourceTime + sqrt((0.5-fX)*(0.5-fX) + (0.5-fY)*(0.5-fY)));
+                fHeight = 1.5 + 0.1*(sinf(fHeight) + cosf(fHeight));
+                GLdouble fResult = (fHeight - fZ)*50.0;
 
-        fDy = fY - sSourcePoint[2].fY;
-        fDz = fZ - sSourcePoint[2].fZ;
-        fResult += 1.0/(fDy*fDy + fDz*fDz);
+                return fResult;
+        }
+};
 
-        return fResult;
+GLfloat fSample1(GLfloat fX, GLfloat fY, GLfloat fZ)
+{
+        return Sample1Density()(fX, fY, fZ);
 }
 
+GLfloat fSample2(GLfloat fX, GLfloat fY, GLfloat fZ)
+{
+        return Sample2Density()(fX, fY, fZ);
+}
 
-//fSample2 defines a height field by plugging the distance from the center into the sin and cos functions
 GLfloat fSample3(GLfloat fX, GLfloat fY, GLfloat fZ)
 {
-        GLfloat fHeight = 20.0*(fTime + sqrt((0.5-fX)*(0.5-fX) + (0.5-fY)*(0.5-fY)));
-        fHeight = 1.5 + 0.1*(sinf(fHeight) + cosf(fHeight));
-        GLdouble fResult = (fHeight - fZ)*50.0;
+        return Sample3Density()(fX, fY, fZ);
+}
 
-        return fResult;
+//vSetSeed picks the noise fSample4 and fSample5 are made of, each seed another world of the same kind
+GLvoid vSetSeed(GLuint iNewSeed)
+{
+        iSeed = iNewSeed;
 }
 
+GLuint iGetSeed()
+{
+        return iSeed;
+}
+
+//fSample4 is a fractal of simplex noise with these settings
+static const GLfloat fSample4Frequency   = 0.8f/1.0f;
+static const GLfloat fSample4Amplitude   = 1.0f;
+static const GLfloat fSample4Lacunarity  = 2.0f;
+static const GLfloat fSample4Persistence = 0.5f;
+static const size_t  iSample4Octaves     = 5;
+//vSample4Lattice may be off fSample4 by this much, so the octaves that vary slowly across its lattice are
+// interpolated from a coarser one (0 evaluates every octave at every point)
+static const GLfloat fSample4LatticeError = 0.05f;
+
 GLfloat fSample4(GLfloat fX, GLfloat fY, GLfloat fZ)
 {
-    size_t octaves = 5;
-    SimplexNoise simplex(0.8f/1.0f, 1.0f, 2.0f, 0.5f);
+    size_t octaves = iSample4Octaves;
+    SimplexNoise simplex(fSample4Frequency, fSample4Amplitude, fSample4Lacunarity, fSample4Persistence, iSeed);
     GLfloat fResult = simplex.fractal(octaves, fX, fY, fZ);
     return fResult;
 }
 
+//vSample4Lattice evaluates fSample4 over a regular lattice, one octave at a time, to within fSample4LatticeError
+GLvoid vSample4Lattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult)
+{
+    size_t octaves = iSample4Octaves;
+    SimplexNoise simplex(fSample4Frequency, fSample4Amplitude, fSample4Lacunarity, fSample4Persistence, iSeed);
+    simplex.fractalLattice(octaves, rsOrigin.fX, rsOrigin.fY, rsOrigin.fZ, rsStep.fX, rsStep.fY, rsStep.fZ,
+                           iCountX, iCountY, iCountZ, pfResult, fSample4LatticeError);
+}
 
-//vGetNormal() finds the gradient of the scalar field at a point
-//This gradient can be used as a very accurate vertx normal for lighting calculations
-GLvoid vGetNormal(GLvector &rfNormal, GLfloat fX, GLfloat fY, GLfloat fZ)
+//vSample4Gradient is the gradient of fSample4, worked out by the noise along with its value
+GLvoid vSample4Gradient(GLfloat fX, GLfloat fY, GLfloat fZ, GLvector &rsGradient)
 {
-        rfNormal.fX = fSample(fX-0.01, fY, fZ) - fSample(fX+0.01, fY, fZ);
-        rfNormal.fY = fSample(fX, fY-0.01, fZ) - fSample(fX, fY+0.01, fZ);
-        rfNormal.fZ = fSample(fX, fY, fZ-0.01) - fSample(fX, fY, fZ+0.01);
-        vNormalizeVector(rfNormal, rfNormal);
+    size_t octaves = iSample4Octaves;
+    SimplexNoise simplex(fSample4Frequency, fSample4Amplitude, fSample4Lacunarity, fSample4Persistence, iSeed);
+    GLfloat afGradient[3];
+    simplex.fractalGradient(octaves, fX, fY, fZ, afGradient);
+    rsGradient.fX = afGradient[0];
+    rsGradient.fY = afGradient[1];
+    rsGradient.fZ = afGradient[2];
 }
 
+//fSample5 is a heightfield: the height of a 2D fractal of simplex noise over (fX, fZ), minus fY, plus a little
+// 3D fractal detail on top (iSample5DetailOctaves = 0 leaves a pure heightfield)
+static const GLfloat fSample5HeightFrequency = 0.25f;
+static const size_t  iSample5HeightOctaves   = 6;
+static const GLfloat fSample5HeightScale     = 2.0f;
+static const GLfloat fSample5DetailFrequency = 1.0f;
+static const size_t  iSample5DetailOctaves   = 2;
+static const GLfloat fSample5DetailAmplitude = 0.15f;
+static const GLfloat fSample5Lacunarity      = 2.0f;
+static const GLfloat fSample5Persistence     = 0.5f;
+
+GLfloat fSample5(GLfloat fX, GLfloat fY, GLfloat fZ)
+{
+    SimplexNoise height(fSample5HeightFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    SimplexNoise detail(fSample5DetailFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    GLfloat fResult = fSample5HeightScale * height.fractal(iSample5HeightOctaves, fX, fZ) - fY;
+    if(iSample5DetailOctaves > 0)
+    {
+        fResult += fSample5DetailAmplitude * detail.fractal(iSample5DetailOctaves, fX, fY, fZ);
+    }
+    return fResult;
+}
 
-//vMarchCube1 performs the Marching Cubes algorithm on a single cube
-GLvoid vMarchCube1(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale)
+//vSample5Lattice evaluates fSample5 over a regular lattice. The height is worked out once per (fX, fZ) column
+// and reused all the way down it, so only the detail costs noise per lattice point
+GLvoid vSample5Lattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult)
 {
-        extern GLint aiCubeEdgeFlags[256];
-        extern GLint a2iTriangleConnectionTable[256][16];
+    SimplexNoise height(fSample5HeightFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    SimplexNoise detail(fSample5DetailFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    std::vector<GLfloat> afHeight(iCountX);
+    GLfloat fDetailAmplitude = iSample5DetailOctaves > 0 ? fSample5DetailAmplitude : 0.0f;
+
+    if(iSample5DetailOctaves > 0)
+    {
+        detail.fractalLattice(iSample5DetailOctaves, rsOrigin.fX, rsOrigin.fY, rsOrigin.fZ, rsStep.fX, rsStep.fY, rsStep.fZ,
+                              iCountX, iCountY, iCountZ, pfResult);
+    }
+    else
+    {
+        std::fill(pfResult, pfResult + (size_t)iCountX * iCountY * iCountZ, 0.0f);
+    }
+    for(GLint iZ = 0; iZ < iCountZ; iZ++)
+    {
+        GLfloat fZ = rsOrigin.fZ + iZ*rsStep.fZ;
+        for(GLint iX = 0; iX < iCountX; iX++)
+        {
+            afHeight[iX] = fSample5HeightScale * height.fractal(iSample5HeightOctaves, rsOrigin.fX + iX*rsStep.fX, fZ);
+        }
+        for(GLint iY = 0; iY < iCountY; iY++)
+        {
+            GLfloat fY = rsOrigin.fY + iY*rsStep.fY;
+            GLfloat *pfRow = pfResult + ((size_t)iZ * iCountY + iY) * iCountX;
+            for(GLint iX = 0; iX < iCountX; iX++)
+            {
+                pfRow[iX] = afHeight[iX] - fY + fDetailAmplitude * pfRow[iX];
+            }
+        }
+    }
+}
 
-        GLint iCorner, iVertex, iVertexTest, iEdge, iTriangle, iFlagIndex, iEdgeFlags;
-        GLfloat fOffset;
-        GLvector sColor;
-        GLfloat afCubeValue[8];
-        GLvector asEdgeVertex[12];
-        GLvector asEdgeNorm[12];
+//vSample5Gradient is the gradient of fSample5: the height's slope across x and z, -1 along y, plus the detail's
+GLvoid vSample5Gradient(GLfloat fX, GLfloat fY, GLfloat fZ, GLvector &rsGradient)
+{
+    SimplexNoise height(fSample5HeightFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    SimplexNoise detail(fSample5DetailFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence, iSeed);
+    GLfloat afHeightGradient[2], afDetailGradient[3] = {0.0f, 0.0f, 0.0f};
+    height.fractalGradient(iSample5HeightOctaves, fX, fZ, afHeightGradient);
+    if(iSample5DetailOctaves > 0)
+    {
+        detail.fractalGradient(iSample5DetailOctaves, fX, fY, fZ, afDetailGradient);
+    }
+    rsGradient.fX = fSample5HeightScale * afHeightGradient[0] + fSample5DetailAmplitude * afDetailGradient[0];
+    rsGradient.fY = -1.0f + fSample5DetailAmplitude * afDetailGradient[1];
+    rsGradient.fZ = fSample5HeightScale * afHeightGradient[1] + fSample5DetailAmplitude * afDetailGradient[2];
+}
+
+//fSampleGraph evaluates the density graph program handed to vSetSampleGraph(), or 0 everywhere without one
+static const DensityProgram *pSampleGraph = nullptr;
+
+GLvoid vSetSampleGraph(const DensityProgram *pProgram)
+{
+    pSampleGraph = pProgram;
+}
+
+GLfloat fSampleGraph(GLfloat fX, GLfloat fY, GLfloat fZ)
+{
+    return pSampleGraph != nullptr ? pSampleGraph->Evaluate(fX, fY, fZ) : 0.0f;
+}
+
+//vSampleGraphLattice runs the program over the lattice in whole batches
+GLvoid vSampleGraphLattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult)
+{
+    if(pSampleGraph == nullptr)
+    {
+        std::fill(pfResult, pfResult + (size_t)iCountX * iCountY * iCountZ, 0.0f);
+        return;
+    }
+    pSampleGraph->Lattice(rsOrigin.fX, rsOrigin.fY, rsOrigin.fZ, rsStep.fX, rsStep.fY, rsStep.fZ,
+                          iCountX, iCountY, iCountZ, pfResult);
+}
 
-        //Make a local copy of the values at the cube's corners
-        for(iVertex = 0; iVertex < 8; iVertex++)
+//vSampleLatticeOf is the lattice form of the density functor Density, compiled with Density inlined
+template <typename Density>
+static GLvoid vSampleLatticeOf(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult)
+{
+        const Density sDensity;
+        for(GLint iZ = 0; iZ < iCountZ; iZ++)
+        for(GLint iY = 0; iY < iCountY; iY++)
         {
-                afCubeValue[iVertex] = fSample(fX + a2fVertexOffset[iVertex][0]*fScale,
-                                                   fY + a2fVertexOffset[iVertex][1]*fScale,
-                                                   fZ + a2fVertexOffset[iVertex][2]*fScale);
+                GLfloat fY = rsOrigin.fY + iY*rsStep.fY;
+                GLfloat fZ = rsOrigin.fZ + iZ*rsStep.fZ;
+                GLfloat *pfRow = pfResult + ((size_t)iZ * iCountY + iY) * iCountX;
+                for(GLint iX = 0; iX < iCountX; iX++)
+                {
+                        pfRow[iX] = sDensity(rsOrigin.fX + iX*rsStep.fX, fY, fZ);
+                }
         }
+}
 
-        //Find which vertices are inside of the surface and which are outside
-        iFlagIndex = 0;
-        for(iVertexTest = 0; iVertexTest < 8; iVertexTest++)
+//fGetSampleLattice maps the density sources F7 switches between to their lattice specializations
+DensityLatticeFunction fGetSampleLattice(DensityFunction fDensity)
+{
+        if(fDensity == fSample1)
         {
-                if(afCubeValue[iVertexTest] <= fTargetValue) 
-                        iFlagIndex |= 1<<iVertexTest;
+                return vSampleLatticeOf<Sample1Density>;
         }
+        if(fDensity == fSample2)
+        {
+                return vSampleLatticeOf<Sample2Density>;
+        }
+        if(fDensity == fSample3)
+        {
+                return vSampleLatticeOf<Sample3Density>;
+        }
+        if(fDensity == fSample4)
+        {
+                return vSample4Lattice;
+        }
+        if(fDensity == fSample5)
+        {
+                return vSample5Lattice;
+        }
+        if(fDensity == fSampleGraph)
+        {
+                return vSampleGraphLattice;
+        }
+        return nullptr;
+}
 
-        //Find which edges are intersected by the surface
-        iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
+DensityGradientFunction fGetSampleGradient(DensityFunction fDensity)
+{
+        if(fDensity == fSample4)
+        {
+                return vSample4Gradient;
+        }
+        if(fDensity == fSample5)
+        {
+                return vSample5Gradient;
+        }
+        return nullptr;
+}
 
-        //If the cube is entirely inside or outside of the surface, then there will be no intersections
-        if(iEdgeFlags == 0) 
+GLfloat fGetSampleLipschitz(DensityFunction fDensity)
+{
+        if(fDensity == fSample3)
         {
-                return;
+                //the height changes by at most 0.1 * sqrt(2) * 20 per unit, so the gradient is at most 50 * sqrt(8 + 1) long
+                return 150.0f;
+        }
+        if(fDensity == fSample4)
+        {
+                size_t octaves = iSample4Octaves;
+                SimplexNoise simplex(fSample4Frequency, fSample4Amplitude, fSample4Lacunarity, fSample4Persistence);
+                return simplex.lipschitz(octaves);
+        }
+        if(fDensity == fSample5)
+        {
+                //(height slope across x and z, -1 along y), plus the detail's gradient
+                SimplexNoise height(fSample5HeightFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence);
+                SimplexNoise detail(fSample5DetailFrequency, 1.0f, fSample5Lacunarity, fSample5Persistence);
+                GLfloat fSlope = fSample5HeightScale * height.lipschitz2D(iSample5HeightOctaves);
+                GLfloat fDetail = iSample5DetailOctaves > 0 ? fSample5DetailAmplitude * detail.lipschitz(iSample5DetailOctaves) : 0.0f;
+                return sqrtf(1.0f + fSlope*fSlope) + fDetail;
         }
+        return 0.0f;
+}
 
-        //Find the point of intersection of the surface with each edge
-        //Then find the normal to the surface at those points
-        for(iEdge = 0; iEdge < 12; iEdge++)
+GLfloat fGetSampleLatticeError(DensityFunction fDensity)
+{
+        if(fDensity == fSample4)
+        {
+                return fSample4LatticeError;
+        }
+        return 0.0f;
+}
+
+GLint iGetSampleKey(DensityFunction fDensity, const char *&rpcName, GLfloat *pfParameter)
+{
+        if(fDensity == fSample1 || fDensity == fSample2 || fDensity == fSample3)
+        {
+                rpcName = fDensity == fSample1 ? "fSample1" : fDensity == fSample2 ? "fSample2" : "fSample3";
+                pfParameter[0] = fTime;
+                return 1;
+        }
+        if(fDensity == fSample4)
         {
-                //if there is an intersection on this edge
-                if(iEdgeFlags & (1<<iEdge))
+                rpcName = "fSample4";
+                pfParameter[0] = fSample4Frequency;
+                pfParameter[1] = fSample4Amplitude;
+                pfParameter[2] = fSample4Lacunarity;
+                pfParameter[3] = fSample4Persistence;
+                pfParameter[4] = (GLfloat)iSample4Octaves;
+                pfParameter[5] = fSample4LatticeError;
+                return 6;
+        }
+        if(fDensity == fSample5)
+        {
+                rpcName = "fSample5";
+                pfParameter[0] = fSample5HeightFrequency;
+                pfParameter[1] = (GLfloat)iSample5HeightOctaves;
+                pfParameter[2] = fSample5HeightScale;
+                pfParameter[3] = fSample5DetailFrequency;
+                pfParameter[4] = (GLfloat)iSample5DetailOctaves;
+                pfParameter[5] = fSample5DetailAmplitude;
+                pfParameter[6] = fSample5Lacunarity;
+                pfParameter[7] = fSample5Persistence;
+                return 8;
+        }
+        if(fDensity == fSampleGraph && pSampleGraph != nullptr)
+        {
+                //the program's hash, 16 bits to a parameter so each is a whole float
+                uint64_t iHash = pSampleGraph->Hash();
+                rpcName = "fSampleGraph";
+                for(GLint iPart = 0; iPart < 4; iPart++)
                 {
-                        fOffset = fGetOffset(afCubeValue[ a2iEdgeConnection[iEdge][0] ], 
-                                                     afCubeValue[ a2iEdgeConnection[iEdge][1] ], fTargetValue);
+                        pfParameter[iPart] = (GLfloat)((iHash >> (16 * iPart)) & 0xFFFF);
+                }
+                return 4;
+        }
+        return -1;
+}
 
-                        asEdgeVertex[iEdge].fX = fX + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][0]  +  fOffset * a2fEdgeDirection[iEdge][0]) * fScale;
-                        asEdgeVertex[iEdge].fY = fY + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][1]  +  fOffset * a2fEdgeDirection[iEdge][1]) * fScale;
-                        asEdgeVertex[iEdge].fZ = fZ + (a2fVertexOffset[ a2iEdgeConnection[iEdge][0] ][2]  +  fOffset * a2fEdgeDirection[iEdge][2]) * fScale;
 
-                        vGetNormal(asEdgeNorm[iEdge], asEdgeVertex[iEdge].fX, asEdgeVertex[iEdge].fY, asEdgeVertex[iEdge].fZ);
-                }
+MarchingCubesMesher::MarchingCubesMesher(DensityFunction fDensity, const GLvector &rsMin, const GLvector &rsMax,
+                                         GLint iResolution, GLfloat fTargetValue, MarchVariant eVariant)
+        : fSample(fDensity), vSampleLattice(fGetSampleLattice(fDensity)), vSampleGradient(fGetSampleGradient(fDensity)),
+          sBoxMin(rsMin), iCells(iResolution), fTargetValue(fTargetValue), eVariant(eVariant),
+          pPool(nullptr), fSkirtDepth(0.0f),
+          fLipschitz(fGetSampleLipschitz(fDensity)), fLatticeError(fGetSampleLatticeError(fDensity)),
+          bExactNormals(true)
+{
+        sCellSize.fX = (rsMax.fX - rsMin.fX) / iResolution;
+        sCellSize.fY = (rsMax.fY - rsMin.fY) / iResolution;
+        sCellSize.fZ = (rsMax.fZ - rsMin.fZ) / iResolution;
+}
+
+//vGetGridNormal() finds the gradient at a lattice point by central differences on the density grid.
+// pfPoint points at the lattice point's sample; the apron around the box keeps all six neighbours in range
+GLvoid MarchingCubesMesher::vGetGridNormal(GLvector &rfNormal, const GLfloat *pfPoint, GLint iGridPoints) const
+{
+        size_t iRow = iGridPoints;
+        size_t iSlab = iRow * iGridPoints;
+
+        rfNormal.fX = (pfPoint[-1] - pfPoint[1]) / (2.0f * sCellSize.fX);
+        rfNormal.fY = (pfPoint[-(ptrdiff_t)iRow] - pfPoint[iRow]) / (2.0f * sCellSize.fY);
+        rfNormal.fZ = (pfPoint[-(ptrdiff_t)iSlab] - pfPoint[iSlab]) / (2.0f * sCellSize.fZ);
+}
+
+
+//iCountCrossings counts how many of the lattice edges from the iCount samples at pfLower to the samples iStep
+// further on cross fTargetValue. There are no branches, so the loop vectorizes
+static GLint iCountCrossings(const GLfloat *pfLower, size_t iStep, GLint iCount, GLfloat fTargetValue)
+{
+        GLint iX, iCrossings = 0;
+        for(iX = 0; iX < iCount; iX++)
+        {
+                iCrossings += (pfLower[iX] <= fTargetValue) != (pfLower[iX + iStep] <= fTargetValue);
+        }
+        return iCrossings;
+}
+
+//iCountTriangles returns how many triangles vMarchCube1 emits for a cube index
+static GLint iCountTriangles(GLint iFlagIndex)
+{
+        extern GLint a2iTriangleConnectionTable[256][16];
+
+        GLint iTriangle;
+        for(iTriangle = 0; iTriangle < 5; iTriangle++)
+        {
+                if(a2iTriangleConnectionTable[iFlagIndex][3*iTriangle] < 0)
+                        break;
+        }
+        return iTriangle;
+}
+
+//iGetTetrahedronIndex picks the vertices of one of the six tetrahedrons within a cube out of the cube's index
+static GLint iGetTetrahedronIndex(GLint iFlagIndex, GLint iTetrahedron)
+{
+        GLint iVertex, iTetrahedronIndex = 0;
+        for(iVertex = 0; iVertex < 4; iVertex++)
+        {
+                if(iFlagIndex & (1<<a2iTetrahedronsInACube[iTetrahedron][iVertex]))
+                        iTetrahedronIndex |= 1<<iVertex;
+        }
+        return iTetrahedronIndex;
+}
+
+//iCountTetrahedronTriangles returns how many triangles vMarchCube2 emits for a cube index
+static GLint iCountTetrahedronTriangles(GLint iFlagIndex)
+{
+        extern GLint a2iTetrahedronTriangles[16][7];
+
+        GLint iTetrahedron, iCount = 0;
+        for(iTetrahedron = 0; iTetrahedron < 6; iTetrahedron++)
+        {
+                GLint iTetrahedronIndex = iGetTetrahedronIndex(iFlagIndex, iTetrahedron);
+                if(a2iTetrahedronTriangles[iTetrahedronIndex][0] >= 0)
+                        iCount += a2iTetrahedronTriangles[iTetrahedronIndex][3] >= 0 ? 2 : 1;
         }
+        return iCount;
+}
 
-        // float vertices[9] = {
+//iGetLatticeDirections returns how many of the a2iLatticeStep edges eVariant cuts
+static GLint iGetLatticeDirections(MarchVariant eVariant)
+{
+        return eVariant == MARCH_TETRAHEDRA ? 7 : 3;
+}
 
-        // };
+//vMakeEdgeVertex finds the point where the surface crosses the lattice edge that starts at lattice point
+// (iX, iY, iZ) and takes a2iLatticeStep[iDirection], and writes its position and normal to pfVertex.
+// pfLower points at the edge's first sample inside the density grid. The normal is vGradient's at the
+// vertex if there is one, else the grid's
+GLvoid MarchingCubesMesher::vMakeEdgeVertex(GLfloat *pfVertex, GLint iX, GLint iY, GLint iZ, GLint iDirection,
+                                            const GLfloat *pfLower, GLint iGridPoints, DensityGradientFunction vGradient) const
+{
+        const GLint *piStep = a2iLatticeStep[iDirection];
+        size_t iStep = ((size_t)piStep[2] * iGridPoints + piStep[1]) * iGridPoints + piStep[0];
+        const GLfloat *pfUpper = pfLower + iStep;
+        GLfloat fOffset = fGetOffset(*pfLower, *pfUpper, fTargetValue);
+        GLvector sLowerNorm, sUpperNorm, sEdgeNorm;
+
+        pfVertex[0] = sBoxMin.fX + (iX + (piStep[0] ? fOffset : 0.0f)) * sCellSize.fX;
+        pfVertex[1] = sBoxMin.fY + (iY + (piStep[1] ? fOffset : 0.0f)) * sCellSize.fY;
+        pfVertex[2] = sBoxMin.fZ + (iZ + (piStep[2] ? fOffset : 0.0f)) * sCellSize.fZ;
+
+        if(vGradient)
+        {
+                //The normal points down the exact gradient at the vertex
+                vGradient(pfVertex[0], pfVertex[1], pfVertex[2], sEdgeNorm);
+                sEdgeNorm.fX = -sEdgeNorm.fX;
+                sEdgeNorm.fY = -sEdgeNorm.fY;
+                sEdgeNorm.fZ = -sEdgeNorm.fZ;
+        }
+        else
+        {
+                //The normal is the gradient at the two lattice points, interpolated like the position
+                vGetGridNormal(sLowerNorm, pfLower, iGridPoints);
+                vGetGridNormal(sUpperNorm, pfUpper, iGridPoints);
+                sEdgeNorm.fX = sLowerNorm.fX + fOffset * (sUpperNorm.fX - sLowerNorm.fX);
+                sEdgeNorm.fY = sLowerNorm.fY + fOffset * (sUpperNorm.fY - sLowerNorm.fY);
+                sEdgeNorm.fZ = sLowerNorm.fZ + fOffset * (sUpperNorm.fZ - sLowerNorm.fZ);
+        }
+        vNormalizeVector(sEdgeNorm, sEdgeNorm);
+
+        pfVertex[3] = sEdgeNorm.fX;
+        pfVertex[4] = sEdgeNorm.fY;
+        pfVertex[5] = sEdgeNorm.fZ;
+}
+
+//vMarchCube1 performs the Marching Cubes algorithm on a single cube whose vertices have already been made.
+// piEdgeVertex maps every intersected lattice edge (lower lattice point * 3 + axis, z counted from the slab's
+// first plane) to the index of its vertex.
+// The cube's triangles are written at rpiIndices, which is advanced past them
+GLvoid MarchingCubesMesher::vMarchCube1(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iFlagIndex,
+                                        const GLuint *piEdgeVertex) const
+{
+        extern GLint a2iTriangleConnectionTable[256][16];
+
+        GLint iCorner, iEdge, iTriangle, iLower;
+        GLint iPoints = iCells + 1;
 
         //Draw the triangles that were found.  There can be up to five per cube
         for(iTriangle = 0; iTriangle < 5; iTriangle++)
@@ -322,180 +736,642 @@ GLvoid vMarchCube1(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale)
                 if(a2iTriangleConnectionTable[iFlagIndex][3*iTriangle] < 0)
                         break;
 
-                ++numOfTris;
- 
-                // 3 vertices * 3 coordinates for each
                 for(iCorner = 0; iCorner < 3; iCorner++)
                 {
-                        iVertex = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
-
-                        vGetColor(sColor, asEdgeVertex[iVertex], asEdgeNorm[iVertex]);
-                        // glColor3f(sColor.fX, sColor.fY, sColor.fZ);
-                        // glNormal3f(asEdgeNorm[iVertex].fX,   asEdgeNorm[iVertex].fY,   asEdgeNorm[iVertex].fZ);
-                        // glVertex3f(asEdgeVertex[iVertex].fX, asEdgeVertex[iVertex].fY, asEdgeVertex[iVertex].fZ);
-                        int offset{3 * (iCorner + numOfTris * 3) };
-						vertices[offset] = asEdgeVertex[iVertex].fX;
-						vertices[offset + 1] = asEdgeVertex[iVertex].fY;
-						vertices[offset + 2] = asEdgeVertex[iVertex].fZ;
+                        iEdge = a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner];
+                        iLower = a2iEdgeLatticeKey[iEdge][0];
+                        size_t iKey = ((((size_t)(iZ + (GLint)a2fVertexOffset[iLower][2]) * iPoints
+                                       + (iY + (GLint)a2fVertexOffset[iLower][1])) * iPoints
+                                       + (iX + (GLint)a2fVertexOffset[iLower][0])) * 3) + a2iEdgeLatticeKey[iEdge][2];
+                        *rpiIndices++ = piEdgeVertex[iKey];
                 }
         }
-        
-        // unsigned int VBO, VAO;
-	    // glGenBuffers(1, &VBO);
-	    // glGenVertexArrays(1, &VAO);
+}
 
-	    // glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	    // glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+//vMarchTetrahedron performs the Marching Tetrahedrons algorithm on one of the six tetrahedrons within a cube.
+// It works like vMarchCube1, but the tetrahedron's edges are keyed as lower lattice point * 7 + a2iLatticeStep
+GLvoid MarchingCubesMesher::vMarchTetrahedron(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iTetrahedron,
+                                              GLint iTetrahedronIndex, const GLuint *piEdgeVertex) const
+{
+        extern GLint a2iTetrahedronTriangles[16][7];
 
-	    // glBindVertexArray(VAO);
+        GLint iCorner, iEdge, iTriangle, iLower;
+        GLint iPoints = iCells + 1;
 
-	    // unsigned int stride{ 3 };
-	    // glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)0);
-	    // glEnableVertexAttribArray(0);
+        //Draw the triangles that were found.  There can be up to 2 per tetrahedron
+        for(iTriangle = 0; iTriangle < 2; iTriangle++)
+        {
+                if(a2iTetrahedronTriangles[iTetrahedronIndex][3*iTriangle] < 0)
+                        break;
 
-	    // glDrawArrays(GL_TRIANGLES, 0, numOfTris * 3);
+                for(iCorner = 0; iCorner < 3; iCorner++)
+                {
+                        iEdge = a2iTetrahedronTriangles[iTetrahedronIndex][3*iTriangle+iCorner];
+                        iLower = a2iTetrahedronEdgeLatticeKey[iTetrahedron][iEdge][0];
+                        size_t iKey = ((((size_t)(iZ + (GLint)a2fVertexOffset[iLower][2]) * iPoints
+                                       + (iY + (GLint)a2fVertexOffset[iLower][1])) * iPoints
+                                       + (iX + (GLint)a2fVertexOffset[iLower][0])) * 7) + a2iTetrahedronEdgeLatticeKey[iTetrahedron][iEdge][1];
+                        *rpiIndices++ = piEdgeVertex[iKey];
+                }
+        }
+}
 
-	    // glDeleteVertexArrays(1, &VAO);
-	    // glDeleteBuffers(1, &VBO);
+//vMarchCube2 performs the Marching Tetrahedrons algorithm on a single cube by making six calls to vMarchTetrahedron
+GLvoid MarchingCubesMesher::vMarchCube2(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iFlagIndex,
+                                        const GLuint *piEdgeVertex) const
+{
+        GLint iTetrahedron;
+        for(iTetrahedron = 0; iTetrahedron < 6; iTetrahedron++)
+        {
+                vMarchTetrahedron(rpiIndices, iX, iY, iZ, iTetrahedron, iGetTetrahedronIndex(iFlagIndex, iTetrahedron), piEdgeVertex);
+        }
 }
 
-//vMarchTetrahedron performs the Marching Tetrahedrons algorithm on a single tetrahedron
-GLvoid vMarchTetrahedron(GLvector *pasTetrahedronPosition, GLfloat *pafTetrahedronValue)
+//vParallelFor runs vTask(i) for every i in [0, iCount), on the worker pool if there is one
+GLvoid MarchingCubesMesher::vParallelFor(GLint iCount, const std::function<void(int)> &vTask) const
 {
-        extern GLint aiTetrahedronEdgeFlags[16];
-        extern GLint a2iTetrahedronTriangles[16][7];
+        if(pPool)
+        {
+                pPool->ParallelFor(iCount, vTask);
+                return;
+        }
+        for(GLint i = 0; i < iCount; i++)
+        {
+                vTask(i);
+        }
+}
 
-        GLint iEdge, iVert0, iVert1, iEdgeFlags, iTriangle, iCorner, iVertex, iFlagIndex = 0;
-        GLfloat fOffset, fInvOffset, fValue = 0.0;
-        GLvector asEdgeVertex[6];
-        GLvector asEdgeNorm[6];
-        GLvector sColor;
+//bMayHoldSurface bounds the density over the whole box from one sample at its centre: a density whose
+// gradient is never longer than fLipschitz stays within fLipschitz times the half diagonal of that value.
+// The box is meshed from lattice values up to fLatticeError off, so the bound grows by that much
+GLboolean MarchingCubesMesher::bMayHoldSurface(GLfloat &rfCentreValue) const
+{
+        if(fLipschitz <= 0.0f)
+        {
+                return true;
+        }
+        GLvector sHalf = {0.5f*iCells*sCellSize.fX, 0.5f*iCells*sCellSize.fY, 0.5f*iCells*sCellSize.fZ};
+        rfCentreValue = fSample(sBoxMin.fX + sHalf.fX, sBoxMin.fY + sHalf.fY, sBoxMin.fZ + sHalf.fZ);
+        GLfloat fReach = fLipschitz * sqrtf(sHalf.fX*sHalf.fX + sHalf.fY*sHalf.fY + sHalf.fZ*sHalf.fZ);
+        if(vSampleLattice)
+        {
+                fReach += fLatticeError;
+        }
+        return fabsf(rfCentreValue - fTargetValue) <= fReach;
+}
 
-        //Find which vertices are inside of the surface and which are outside
-        for(iVertex = 0; iVertex < 4; iVertex++)
+//bFindActiveBlocks applies the same bound to every block of iSkipBlockCells cells along each axis.
+// Blocks that cannot reach fTargetValue are inactive in abActive, x fastest, and afBlockValue holds the
+// value at their centre, which is on the same side of the surface as the rest of the block. Centres taken
+// from the lattice, and the lattice grid they stand for, may each be fLatticeError off, so the bound
+// grows by twice that. abActive is left empty when every block is active
+GLboolean MarchingCubesMesher::bFindActiveBlocks(std::vector<GLboolean> &abActive, std::vector<GLfloat> &afBlockValue) const
+{
+        GLint iBlocks = (iCells + iSkipBlockCells - 1) / iSkipBlockCells;
+        size_t iNumBlocks = (size_t)iBlocks * iBlocks * iBlocks;
+        GLvector sBlockSize = {iSkipBlockCells*sCellSize.fX, iSkipBlockCells*sCellSize.fY, iSkipBlockCells*sCellSize.fZ};
+        GLvector sFirstCentre = {sBoxMin.fX + 0.5f*sBlockSize.fX, sBoxMin.fY + 0.5f*sBlockSize.fY, sBoxMin.fZ + 0.5f*sBlockSize.fZ};
+        GLfloat fReach = 0.5f * fLipschitz * sqrtf(sBlockSize.fX*sBlockSize.fX + sBlockSize.fY*sBlockSize.fY + sBlockSize.fZ*sBlockSize.fZ);
+        if(vSampleLattice)
         {
-                if(pafTetrahedronValue[iVertex] <= fTargetValue) 
-                        iFlagIndex |= 1<<iVertex;
+                fReach += 2.0f * fLatticeError;
         }
 
-        //Find which edges are intersected by the surface
-        iEdgeFlags = aiTetrahedronEdgeFlags[iFlagIndex];
+        abActive.clear();
+        afBlockValue.clear();
+        if(fLipschitz <= 0.0f)
+        {
+                return true;
+        }
 
-        //If the tetrahedron is entirely inside or outside of the surface, then there will be no intersections
-        if(iEdgeFlags == 0)
+        //a block at the far faces may hang over the box; its bound then covers more than it needs to
+        afBlockValue.resize(iNumBlocks);
+        if(vSampleLattice)
         {
-                return;
+                vSampleLattice(sFirstCentre, sBlockSize, iBlocks, iBlocks, iBlocks, afBlockValue.data());
         }
-        //Find the point of intersection of the surface with each edge
-        // Then find the normal to the surface at those points
-        for(iEdge = 0; iEdge < 6; iEdge++)
+        else
         {
-                //if there is an intersection on this edge
-                if(iEdgeFlags & (1<<iEdge))
+                size_t iBlock = 0;
+                for(GLint iZ = 0; iZ < iBlocks; iZ++)
+                for(GLint iY = 0; iY < iBlocks; iY++)
+                for(GLint iX = 0; iX < iBlocks; iX++)
                 {
-                        iVert0 = a2iTetrahedronEdgeConnection[iEdge][0];
-                        iVert1 = a2iTetrahedronEdgeConnection[iEdge][1];
-                        fOffset = fGetOffset(pafTetrahedronValue[iVert0], pafTetrahedronValue[iVert1], fTargetValue);
-                        fInvOffset = 1.0 - fOffset;
-
-                        asEdgeVertex[iEdge].fX = fInvOffset*pasTetrahedronPosition[iVert0].fX  +  fOffset*pasTetrahedronPosition[iVert1].fX;
-                        asEdgeVertex[iEdge].fY = fInvOffset*pasTetrahedronPosition[iVert0].fY  +  fOffset*pasTetrahedronPosition[iVert1].fY;
-                        asEdgeVertex[iEdge].fZ = fInvOffset*pasTetrahedronPosition[iVert0].fZ  +  fOffset*pasTetrahedronPosition[iVert1].fZ;
-                        
-                        vGetNormal(asEdgeNorm[iEdge], asEdgeVertex[iEdge].fX, asEdgeVertex[iEdge].fY, asEdgeVertex[iEdge].fZ);
+                        afBlockValue[iBlock++] = fSample(sFirstCentre.fX + iX*sBlockSize.fX, sFirstCentre.fY + iY*sBlockSize.fY,
+                                                         sFirstCentre.fZ + iZ*sBlockSize.fZ);
                 }
         }
-        //Draw the triangles that were found.  There can be up to 2 per tetrahedron
-        for(iTriangle = 0; iTriangle < 2; iTriangle++)
+
+        size_t iNumActive = 0;
+        abActive.resize(iNumBlocks);
+        for(size_t iBlock = 0; iBlock < iNumBlocks; iBlock++)
         {
-                if(a2iTetrahedronTriangles[iFlagIndex][3*iTriangle] < 0)
-                        break;
+                abActive[iBlock] = fabsf(afBlockValue[iBlock] - fTargetValue) <= fReach;
+                iNumActive += abActive[iBlock];
+        }
+        if(iNumActive == iNumBlocks)
+        {
+                abActive.clear();
+                afBlockValue.clear();
+        }
+        return iNumActive > 0;
+}
 
-                for(iCorner = 0; iCorner < 3; iCorner++)
-                {
-                        iVertex = a2iTetrahedronTriangles[iFlagIndex][3*iTriangle+iCorner];
+//vFillDensityGrid samples the density source once at every lattice point of the box, plus a one
+// point apron on every side so normals can be taken by central differences up to the box faces.
+// afGrid is laid out x fastest, then y, then z, with iCells+3 points along each axis;
+// lattice point (0, 0, 0) of the box is at grid point (1, 1, 1).
+// Only the iNumOfPlanes z planes from grid plane iFirstPlane on are filled, afGrid starting with iFirstPlane.
+// With blocks from bFindActiveBlocks only the points within one lattice step of an active block are
+// sampled, which covers every edge that can cross the surface and the neighbours its normals read;
+// the other points get their block's centre value, so they classify correctly but carry no detail
+GLvoid MarchingCubesMesher::vFillDensityGrid(std::vector<GLfloat> &afGrid, const std::vector<GLboolean> &abActive,
+                                             const std::vector<GLfloat> &afBlockValue, GLint iFirstPlane, GLint iNumOfPlanes) const
+{
+        GLint iGridPoints = iCells + 3;
+        GLint iBlocks = (iCells + iSkipBlockCells - 1) / iSkipBlockCells;
 
-                        vGetColor(sColor, asEdgeVertex[iVertex], asEdgeNorm[iVertex]);
-                        // glColor3f(sColor.fX, sColor.fY, sColor.fZ);
-                        // glNormal3f(asEdgeNorm[iVertex].fX,   asEdgeNorm[iVertex].fY,   asEdgeNorm[iVertex].fZ);
-                        // glVertex3f(asEdgeVertex[iVertex].fX, asEdgeVertex[iVertex].fY, asEdgeVertex[iVertex].fZ);
-                }
+        //the blocks within one lattice step of grid point iPoint along an axis are iLowBlock..iHighBlock;
+        // block iBlock spans lattice points iBlock*iSkipBlockCells to (iBlock+1)*iSkipBlockCells
+        std::vector<GLint> aiLowBlock(iGridPoints), aiHighBlock(iGridPoints), aiOwnBlock(iGridPoints);
+        for(GLint iPoint = 0; iPoint < iGridPoints; iPoint++)
+        {
+                GLint iLattice = iPoint - 1;
+                aiLowBlock[iPoint]  = std::max((iLattice + iSkipBlockCells - 2) / iSkipBlockCells - 1, 0);
+                aiHighBlock[iPoint] = std::min((iLattice + 1) / iSkipBlockCells, iBlocks - 1);
+                aiOwnBlock[iPoint]  = std::min(std::max(iLattice, 0) / iSkipBlockCells, iBlocks - 1);
         }
+
+        afGrid.resize((size_t)iNumOfPlanes * iGridPoints * iGridPoints);
+        vParallelFor(iNumOfPlanes, [&](int iPlane)
+        {
+                GLint iX, iY, iZ = iFirstPlane + iPlane;
+                GLfloat fZ = sBoxMin.fZ + (iZ - 1)*sCellSize.fZ;
+                if(vSampleLattice && abActive.empty())
+                {
+                        // the whole z plane in one call, apron included
+                        GLvector sOrigin = {sBoxMin.fX - sCellSize.fX, sBoxMin.fY - sCellSize.fY, fZ};
+                        vSampleLattice(sOrigin, sCellSize, iGridPoints, iGridPoints, 1, &afGrid[(size_t)iPlane * iGridPoints * iGridPoints]);
+                        return;
+                }
+                std::vector<GLboolean> abRowActive(iBlocks);
+                for(iY = 0; iY < iGridPoints; iY++)
+                {
+                        GLfloat *pfRow = &afGrid[((size_t)iPlane * iGridPoints + iY) * iGridPoints];
+                        GLfloat fY = sBoxMin.fY + (iY - 1)*sCellSize.fY;
+                        if(abActive.empty())
+                        {
+                                for(iX = 0; iX < iGridPoints; iX++)
+                                {
+                                        pfRow[iX] = fSample(sBoxMin.fX + (iX - 1)*sCellSize.fX, fY, fZ);
+                                }
+                                continue;
+                        }
+
+                        //which columns of blocks have an active block near this row
+                        std::fill(abRowActive.begin(), abRowActive.end(), (GLboolean)false);
+                        for(GLint iBlockZ = aiLowBlock[iZ]; iBlockZ <= aiHighBlock[iZ]; iBlockZ++)
+                        for(GLint iBlockY = aiLowBlock[iY]; iBlockY <= aiHighBlock[iY]; iBlockY++)
+                        for(GLint iBlockX = 0; iBlockX < iBlocks; iBlockX++)
+                        {
+                                abRowActive[iBlockX] |= abActive[((size_t)iBlockZ * iBlocks + iBlockY) * iBlocks + iBlockX];
+                        }
+                        const GLfloat *pfOwnBlockValue = &afBlockValue[((size_t)aiOwnBlock[iZ] * iBlocks + aiOwnBlock[iY]) * iBlocks];
+
+                        for(iX = 0; iX < iGridPoints;)
+                        {
+                                GLint iRunEnd = iX;
+                                while(iRunEnd < iGridPoints && (abRowActive[aiLowBlock[iRunEnd]] || abRowActive[aiHighBlock[iRunEnd]]))
+                                {
+                                        iRunEnd++;
+                                }
+                                if(iRunEnd == iX)
+                                {
+                                        pfRow[iX] = pfOwnBlockValue[aiOwnBlock[iX]];
+                                        iX++;
+                                        continue;
+                                }
+                                if(vSampleLattice)
+                                {
+                                        GLvector sOrigin = {sBoxMin.fX + (iX - 1)*sCellSize.fX, fY, fZ};
+                                        vSampleLattice(sOrigin, sCellSize, iRunEnd - iX, 1, 1, pfRow + iX);
+                                        iX = iRunEnd;
+                                        continue;
+                                }
+                                for(; iX < iRunEnd; iX++)
+                                {
+                                        pfRow[iX] = fSample(sBoxMin.fX + (iX - 1)*sCellSize.fX, fY, fZ);
+                                }
+                        }
+                }
+        });
 }
 
+//vSampleGrid fills afGrid the way vFillDensityGrid lays it out, even where the surface cannot reach:
+// a box the surface misses entirely gets its centre value everywhere
+GLvoid MarchingCubesMesher::vSampleGrid(std::vector<GLfloat> &afGrid) const
+{
+        GLint iGridPoints = iCells + 3;
+        GLfloat fCentreValue;
+        std::vector<GLfloat> afBlockValue;
+        std::vector<GLboolean> abActive;
 
+        if(!bMayHoldSurface(fCentreValue))
+        {
+                afGrid.assign((size_t)iGridPoints * iGridPoints * iGridPoints, fCentreValue);
+                return;
+        }
+        bFindActiveBlocks(abActive, afBlockValue);
+        vFillDensityGrid(afGrid, abActive, afBlockValue, 0, iGridPoints);
+}
 
-//vMarchCube2 performs the Marching Tetrahedrons algorithm on a single cube by making six calls to vMarchTetrahedron
-GLvoid vMarchCube2(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale)
+//vMesh samples the box once and extracts the surface from the samples like vMeshGrid, but with the normals of
+// fGetSampleGradient() where the source has them
+GLvoid MarchingCubesMesher::vMesh(MarchingCubesMesh &rsMesh) const
 {
-        GLint iVertex, iTetrahedron, iVertexInACube;
-        GLvector asCubePosition[8];
-        GLfloat  afCubeValue[8];
-        GLvector asTetrahedronPosition[4];
-        GLfloat  afTetrahedronValue[4];
+        GLfloat fCentreValue;
+        std::vector<GLfloat> afGrid, afBlockValue;
+        std::vector<GLboolean> abActive;
 
-        //Make a local copy of the cube's corner positions
-        for(iVertex = 0; iVertex < 8; iVertex++)
+        //empty space skipping: boxes and blocks the surface cannot reach are not sampled
+        if(!bMayHoldSurface(fCentreValue) || !bFindActiveBlocks(abActive, afBlockValue))
         {
-                asCubePosition[iVertex].fX = fX + a2fVertexOffset[iVertex][0]*fScale;
-                asCubePosition[iVertex].fY = fY + a2fVertexOffset[iVertex][1]*fScale;
-                asCubePosition[iVertex].fZ = fZ + a2fVertexOffset[iVertex][2]*fScale;
+                return;
         }
+        vFillDensityGrid(afGrid, abActive, afBlockValue, 0, iCells + 3);
+        vMarchBox(rsMesh, afGrid, bExactNormals ? vSampleGradient : nullptr);
+}
 
-        //Make a local copy of the cube's corner values
-        for(iVertex = 0; iVertex < 8; iVertex++)
+//vMarchGrid extracts the surface of the slab of iNumOfCells cell layers from layer iFirstCell on, in four
+// passes over its z planes:
+//  1. count the intersected lattice edges whose lower point lies in each lattice plane
+//  2. make the vertex of every such edge at its plane's prefix-sum offset
+//  3. classify every cell and count the triangles of each layer of cells
+//  4. write each layer's triangles at its prefix-sum offset
+// Planes and layers are the unit of work for the worker pool. Each one's place in the output only depends on
+// the ones before it, so the mesh is the same whatever the number of threads.
+// Cubes that share an edge share the vertex on it, so the output is an indexed, welded mesh.
+// MARCH_TETRAHEDRA splits every cell into the six tetrahedrons of a2iTetrahedronsInACube instead; their edges
+// are the lattice edges of a2iLatticeStep, so they weld across cells the same way.
+// pfGrid holds grid planes iFirstCell to iFirstCell+iNumOfCells+2 of the vFillDensityGrid layout.
+// piEdgeVertex has room for the edges of lattice planes iFirstCell to iFirstCell+iNumOfCells. The edges
+// within the top plane are made here, so a slab that follows finds them in the slab's top plane of piEdgeVertex;
+// moved to its first plane, they weld the next slab to this one (see vMeshStream).
+// The first vertex of rsMesh is vertex iBaseVertex of the whole surface; new vertices are appended and
+// referred to by that count.
+// It is compiled once per variant, so the edge directions and the cell polygonizer are fixed in its loops
+template <MarchVariant eMarch>
+GLvoid MarchingCubesMesher::vMarchGrid(MarchingCubesMesh &rsMesh, GLuint iBaseVertex, const GLfloat *pfGrid,
+                                       GLint iFirstCell, GLint iNumOfCells, GLuint *piEdgeVertex,
+                                       DensityGradientFunction vGradient) const
+{
+        GLint iPlane;
+        GLint iPoints = iCells + 1;
+        GLint iGridPoints = iCells + 3;
+        GLint iLastCell = iFirstCell + iNumOfCells;
+        const GLint iDirections = iGetLatticeDirections(eMarch);
+        //a local copy, the compiler cannot tell that the loops below writing bytes leave it alone
+        const GLfloat fTarget = fTargetValue;
+        size_t aiDirectionStep[7];
+
+        // grid sample of a lattice point of the box
+        auto pfLattice = [&](GLint iX, GLint iY, GLint iZ) -> const GLfloat *
+        {
+                return &pfGrid[((size_t)(iZ + 1 - iFirstCell) * iGridPoints + (iY + 1)) * iGridPoints + (iX + 1)];
+        };
+        // whether the lattice edge starting at pfLower and going iStep samples further crosses the surface
+        auto bCrossed = [&](const GLfloat *pfLower, size_t iStep) -> bool
+        {
+                return (pfLower[0] <= fTarget) != (pfLower[iStep] <= fTarget);
+        };
+        for(GLint iDirection = 0; iDirection < iDirections; iDirection++)
         {
-                afCubeValue[iVertex] = fSample(asCubePosition[iVertex].fX,
-                                                   asCubePosition[iVertex].fY,
-                                               asCubePosition[iVertex].fZ);
+                const GLint *piStep = a2iLatticeStep[iDirection];
+                aiDirectionStep[iDirection] = ((size_t)piStep[2] * iGridPoints + piStep[1]) * iGridPoints + piStep[0];
         }
+        // whether this slab makes the vertices of lattice edges starting in plane iZ along a2iLatticeStep[iDirection]:
+        // edges leaving the plane upwards belong to the slab below the top plane, edges within the first
+        // plane to the slab before
+        auto bOwned = [&](GLint iZ, GLint iDirection) -> bool
+        {
+                return a2iLatticeStep[iDirection][2] ? iZ < iLastCell : iZ > iFirstCell || iFirstCell == 0;
+        };
+        // whether the lattice edge starting at (iX, iY, iZ) along a2iLatticeStep[iDirection] stays inside the box
+        auto bInside = [&](GLint iX, GLint iY, GLint iDirection) -> bool
+        {
+                const GLint *piStep = a2iLatticeStep[iDirection];
+                return iX + piStep[0] <= iCells && iY + piStep[1] <= iCells;
+        };
+
+        //Pass 1: count the vertices of every lattice row and plane, a whole row of edges at a time
+        std::vector<GLuint> aiPlaneStart(iNumOfCells + 2, 0);
+        std::vector<GLuint> aiRowCount((size_t)(iNumOfCells + 1) * iPoints);
+        vParallelFor(iNumOfCells + 1, [&](int iPlane)
+        {
+                GLint iZ = iFirstCell + iPlane;
+                GLuint iCount = 0;
+                for(GLint iY = 0; iY < iPoints; iY++)
+                {
+                        GLuint iRowCount = 0;
+                        for(GLint iDirection = 0; iDirection < iDirections; iDirection++)
+                        {
+                                const GLint *piStep = a2iLatticeStep[iDirection];
+                                if(iY + piStep[1] <= iCells && bOwned(iZ, iDirection))
+                                        iRowCount += iCountCrossings(pfLattice(0, iY, iZ), aiDirectionStep[iDirection], iPoints - piStep[0], fTarget);
+                        }
+                        aiRowCount[(size_t)iPlane * iPoints + iY] = iRowCount;
+                        iCount += iRowCount;
+                }
+                aiPlaneStart[iPlane + 1] = iCount;
+        });
 
-        for(iTetrahedron = 0; iTetrahedron < 6; iTetrahedron++)
+        aiPlaneStart[0] = iBaseVertex + rsMesh.iNumOfVertices();
+        for(iPlane = 0; iPlane <= iNumOfCells; iPlane++)
+        {
+                aiPlaneStart[iPlane + 1] += aiPlaneStart[iPlane];
+        }
+
+        //Pass 2: make the vertices, remembering which edge each one sits on. Only the entries of intersected
+        // edges are ever read, so the edge map need not be initialized
+        rsMesh.vertices.resize((size_t)(aiPlaneStart[iNumOfCells + 1] - iBaseVertex) * MarchingCubesMesh::iStride);
+        vParallelFor(iNumOfCells + 1, [&](int iPlane)
+        {
+                GLint iZ = iFirstCell + iPlane;
+                GLuint iNextVertex = aiPlaneStart[iPlane];
+                for(GLint iY = 0; iY < iPoints; iY++)
+                {
+                        if(aiRowCount[(size_t)iPlane * iPoints + iY] == 0)
+                                continue;
+                        for(GLint iX = 0; iX < iPoints; iX++)
+                        {
+                                const GLfloat *pfLower = pfLattice(iX, iY, iZ);
+                                size_t iKey = (((size_t)iPlane * iPoints + iY) * iPoints + iX) * iDirections;
+                                for(GLint iDirection = 0; iDirection < iDirections; iDirection++)
+                                {
+                                        if(bInside(iX, iY, iDirection) && bOwned(iZ, iDirection) && bCrossed(pfLower, aiDirectionStep[iDirection]))
+                                        {
+                                                vMakeEdgeVertex(&rsMesh.vertices[(size_t)(iNextVertex - iBaseVertex) * MarchingCubesMesh::iStride],
+                                                                iX, iY, iZ, iDirection, pfLower, iGridPoints, vGradient);
+                                                piEdgeVertex[iKey + iDirection] = iNextVertex++;
+                                        }
+                                }
+                        }
+                }
+        });
+
+        //Pass 3: classify the cells and count the triangles of every layer
+        std::vector<GLubyte> aiCubeIndex((size_t)iNumOfCells * iCells * iCells);
+        std::vector<size_t> aiLayerStart(iNumOfCells + 1, 0);
+        vParallelFor(iNumOfCells, [&](int iLayer)
         {
-                for(iVertex = 0; iVertex < 4; iVertex++)
+                GLint iZ = iFirstCell + iLayer;
+                size_t iCount = 0;
+                for(GLint iY = 0; iY < iCells; iY++)
                 {
-                        iVertexInACube = a2iTetrahedronsInACube[iTetrahedron][iVertex];
-                        asTetrahedronPosition[iVertex].fX = asCubePosition[iVertexInACube].fX;
-                        asTetrahedronPosition[iVertex].fY = asCubePosition[iVertexInACube].fY;
-                        asTetrahedronPosition[iVertex].fZ = asCubePosition[iVertexInACube].fZ;
-                        afTetrahedronValue[iVertex] = afCubeValue[iVertexInACube];
+                        //the rows of samples along vertices 0, 3, 4 and 7 of this row of cubes; vertices 1, 2, 5
+                        // and 6 are the next sample along each. A vertex below fTarget sets its bit of the cube index
+                        const GLfloat *pfRow0 = pfLattice(0, iY, iZ);
+                        const GLfloat *pfRow3 = pfRow0 + aiDirectionStep[1];
+                        const GLfloat *pfRow4 = pfRow0 + aiDirectionStep[2];
+                        const GLfloat *pfRow7 = pfRow4 + aiDirectionStep[1];
+                        GLubyte *piCubeIndex = &aiCubeIndex[((size_t)iLayer * iCells + iY) * iCells];
+                        for(GLint iX = 0; iX < iCells; iX++)
+                        {
+                                piCubeIndex[iX] = (GLubyte)((pfRow0[iX] <= fTarget)
+                                                          | (pfRow0[iX + 1] <= fTarget) << 1
+                                                          | (pfRow3[iX + 1] <= fTarget) << 2
+                                                          | (pfRow3[iX] <= fTarget) << 3
+                                                          | (pfRow4[iX] <= fTarget) << 4
+                                                          | (pfRow4[iX + 1] <= fTarget) << 5
+                                                          | (pfRow7[iX + 1] <= fTarget) << 6
+                                                          | (pfRow7[iX] <= fTarget) << 7);
+                        }
+                        for(GLint iX = 0; iX < iCells; iX++)
+                        {
+                                GLint iFlagIndex = piCubeIndex[iX];
+                                if(iFlagIndex != 0 && iFlagIndex != 255)
+                                        iCount += eMarch == MARCH_TETRAHEDRA ? iCountTetrahedronTriangles(iFlagIndex) : iCountTriangles(iFlagIndex);
+                        }
                 }
-                vMarchTetrahedron(asTetrahedronPosition, afTetrahedronValue);
+                aiLayerStart[iLayer + 1] = iCount * 3;
+        });
+
+        aiLayerStart[0] = rsMesh.indices.size();
+        for(iPlane = 0; iPlane < iNumOfCells; iPlane++)
+        {
+                aiLayerStart[iPlane + 1] += aiLayerStart[iPlane];
         }
+
+        //Pass 4: write the triangles. The cube functions count z from the slab's first plane, like piEdgeVertex
+        rsMesh.indices.resize(aiLayerStart[iNumOfCells]);
+        vParallelFor(iNumOfCells, [&](int iLayer)
+        {
+                GLuint *piIndices = rsMesh.indices.data() + aiLayerStart[iLayer];
+                for(GLint iY = 0; iY < iCells; iY++)
+                for(GLint iX = 0; iX < iCells; iX++)
+                {
+                        GLint iFlagIndex = aiCubeIndex[((size_t)iLayer * iCells + iY) * iCells + iX];
+                        if(iFlagIndex == 0 || iFlagIndex == 255)
+                                continue;
+                        if(eMarch == MARCH_TETRAHEDRA)
+                                vMarchCube2(piIndices, iX, iY, iLayer, iFlagIndex, piEdgeVertex);
+                        else
+                                vMarchCube1(piIndices, iX, iY, iLayer, iFlagIndex, piEdgeVertex);
+                }
+        });
 }
-        
 
-//vMarchingCubes iterates over the entire dataset, calling vMarchCube on each cube
-GLvoid vMarchingCubes(GLuint *VBO, GLuint *VAO, GLuint *numOfTrianglesVariable)
+//vMarchSlab runs the vMarchGrid of the mesher's variant
+GLvoid MarchingCubesMesher::vMarchSlab(MarchingCubesMesh &rsMesh, GLuint iBaseVertex, const GLfloat *pfGrid,
+                                       GLint iFirstCell, GLint iNumOfCells, GLuint *piEdgeVertex,
+                                       DensityGradientFunction vGradient) const
 {
-        numOfTris = 0;
-        GLint iX, iY, iZ;
-        // NOTE: multiply iDataSetSize's to chance simulation(chunk) size
-        for(iX = 0; iX < iDataSetSize * 2; iX++)
-        for(iY = 0; iY < iDataSetSize * 2; iY++)
-        for(iZ = 0; iZ < iDataSetSize * 2; iZ++)
+        if(eVariant == MARCH_TETRAHEDRA)
+        {
+                vMarchGrid<MARCH_TETRAHEDRA>(rsMesh, iBaseVertex, pfGrid, iFirstCell, iNumOfCells, piEdgeVertex, vGradient);
+        }
+        else
         {
-                vMarchCube(iX*fStepSize, iY*fStepSize, iZ*fStepSize, fStepSize);
+                vMarchGrid<MARCH_CUBES>(rsMesh, iBaseVertex, pfGrid, iFirstCell, iNumOfCells, piEdgeVertex, vGradient);
         }
+}
 
-		glGenBuffers(1, VBO);
-		glGenVertexArrays(1, VAO);
+//vMeshGrid marches a grid that may hold edits, with normals from the grid
+GLvoid MarchingCubesMesher::vMeshGrid(MarchingCubesMesh &rsMesh, const std::vector<GLfloat> &afGrid) const
+{
+        vMarchBox(rsMesh, afGrid, nullptr);
+}
+
+//vMarchBox marches the whole box as one slab
+GLvoid MarchingCubesMesher::vMarchBox(MarchingCubesMesh &rsMesh, const std::vector<GLfloat> &afGrid,
+                                      DensityGradientFunction vGradient) const
+{
+        GLint iPoints = iCells + 1;
+        GLuint iFirstVertex = rsMesh.iNumOfVertices();
+        size_t iFirstIndex = rsMesh.indices.size();
+        std::unique_ptr<GLuint[]> piEdgeVertex(new GLuint[(size_t)iPoints * iPoints * iPoints * iGetLatticeDirections(eVariant)]);
+
+        vMarchSlab(rsMesh, 0, afGrid.data(), 0, iCells, piEdgeVertex.get(), vGradient);
+        if(fSkirtDepth > 0.0f)
+        {
+                vAddSkirts(rsMesh, iFirstVertex, iFirstIndex);
+        }
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, *VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+//vMeshStream meshes the box in slabs of at most iSlabCells cell layers, sampling only one slab (and its apron)
+// at a time, and hands the surface to vSink in batches of iBatchTriangles triangles (the last one may hold fewer).
+// A batch carries the vertices made since the previous one, which are vertices iFirstVertex on of the whole
+// surface, and triangles indexing the whole surface; a triangle only uses vertices of its own or earlier batches.
+// Slabs share the edge vertices of the plane between them, so the surface is welded as vMesh welds it, though
+// its vertices come in another order. The grid, edge map and batch buffers are reused from slab to slab, so
+// memory stays in proportion to iCells^2 * iSlabCells whatever the resolution. Skirts are not streamed
+GLvoid MarchingCubesMesher::vMeshStream(const MeshBatchSink &vSink, GLuint iBatchTriangles, GLint iSlabCells) const
+{
+        GLint iPoints = iCells + 1;
+        GLint iFirstCell, iNumOfCells;
+        GLfloat fCentreValue;
+        std::vector<GLfloat> afGrid, afBlockValue;
+        std::vector<GLboolean> abActive;
+        MarchingCubesMesh sPending, sBatch;
+        GLuint iPendingVertex = 0;
+
+        if(!bMayHoldSurface(fCentreValue) || !bFindActiveBlocks(abActive, afBlockValue))
+        {
+                return;
+        }
+        iSlabCells = std::max(std::min(iSlabCells, iCells), 1);
+        iBatchTriangles = std::max(iBatchTriangles, 1u);
+        size_t iPlaneKeys = (size_t)iPoints * iPoints * iGetLatticeDirections(eVariant);
+        std::unique_ptr<GLuint[]> piEdgeVertex(new GLuint[iPlaneKeys * (iSlabCells + 1)]);
+
+        //hands on the pending vertices with iTriangles pending triangles from triangle iFirst on; sBatch's buffers
+        // go back to sPending afterwards, so neither is reallocated batch after batch
+        auto vFlush = [&](size_t iFirst, size_t iTriangles)
+        {
+                sBatch.vertices.swap(sPending.vertices);
+                sBatch.indices.assign(sPending.indices.begin() + iFirst * 3, sPending.indices.begin() + (iFirst + iTriangles) * 3);
+                vSink(sBatch, iPendingVertex);
+                iPendingVertex += sBatch.iNumOfVertices();
+                sBatch.vertices.clear();
+                sBatch.vertices.swap(sPending.vertices);
+        };
+
+        for(iFirstCell = 0; iFirstCell < iCells; iFirstCell += iNumOfCells)
+        {
+                iNumOfCells = std::min(iSlabCells, iCells - iFirstCell);
+                vFillDensityGrid(afGrid, abActive, afBlockValue, iFirstCell, iNumOfCells + 3);
+                vMarchSlab(sPending, iPendingVertex, afGrid.data(), iFirstCell, iNumOfCells, piEdgeVertex.get(),
+                           bExactNormals ? vSampleGradient : nullptr);
+                //the top plane's edges become the next slab's first plane
+                std::copy(piEdgeVertex.get() + iPlaneKeys * iNumOfCells, piEdgeVertex.get() + iPlaneKeys * (iNumOfCells + 1),
+                          piEdgeVertex.get());
+
+                size_t iSent = 0;
+                for(; sPending.iNumOfTriangles() - iSent >= iBatchTriangles; iSent += iBatchTriangles)
+                {
+                        vFlush(iSent, iBatchTriangles);
+                }
+                sPending.indices.erase(sPending.indices.begin(), sPending.indices.begin() + iSent * 3);
+        }
+        if(sPending.iNumOfTriangles() > 0 || sPending.iNumOfVertices() > 0)
+        {
+                vFlush(0, sPending.iNumOfTriangles());
+        }
+}
 
-		glBindVertexArray(*VAO);
+//iGetBoxFaces returns which faces of the box (bit 0 = -x, 1 = +x, 2 = -y, 3 = +y, 4 = -z, 5 = +z) a vertex lies on
+GLint MarchingCubesMesher::iGetBoxFaces(const GLfloat *pfVertex) const
+{
+        GLint iFaces = 0;
+        if(pfVertex[0] == sBoxMin.fX)                          iFaces |= 1;
+        if(pfVertex[0] == sBoxMin.fX + iCells*sCellSize.fX)    iFaces |= 2;
+        if(pfVertex[1] == sBoxMin.fY)                          iFaces |= 4;
+        if(pfVertex[1] == sBoxMin.fY + iCells*sCellSize.fY)    iFaces |= 8;
+        if(pfVertex[2] == sBoxMin.fZ)                          iFaces |= 16;
+        if(pfVertex[2] == sBoxMin.fZ + iCells*sCellSize.fZ)    iFaces |= 32;
+        return iFaces;
+}
 
-		GLuint stride{ 3 };
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
+//vAddSkirts hangs a strip of triangles fSkirtDepth deep below every edge where the surface leaves the box.
+// A neighbouring box meshed at another resolution ends its surface along a slightly different line on the
+// shared face; the skirt behind the gap hides the crack between them.
+// Only vertices from iFirstVertex and triangles from iFirstIndex on, i.e. those of the current vMeshGrid call, are looked at
+GLvoid MarchingCubesMesher::vAddSkirts(MarchingCubesMesh &rsMesh, GLuint iFirstVertex, size_t iFirstIndex) const
+{
+        const GLint iStride = MarchingCubesMesh::iStride;
+        GLuint iVertex, iNumOfVertices = rsMesh.iNumOfVertices();
+        size_t iIndex, iNumOfIndices = rsMesh.indices.size();
+        GLint iCorner;
 
-        *numOfTrianglesVariable = numOfTris;
+        std::vector<GLubyte> aiFaces(iNumOfVertices - iFirstVertex);
+        for(iVertex = iFirstVertex; iVertex < iNumOfVertices; iVertex++)
+        {
+                aiFaces[iVertex - iFirstVertex] = (GLubyte)iGetBoxFaces(&rsMesh.vertices[(size_t)iVertex * iStride]);
+        }
 
-	    // glDrawArrays(GL_TRIANGLES, 0, numOfTris * 3);
+        //Collect the triangle edges lying in a face of the box. The ones used by a single triangle are the border
+        std::vector<GLuint> aiBorder;
+        std::unordered_map<GLuint64, size_t> aiBorderSlot;
+        for(iIndex = iFirstIndex; iIndex < iNumOfIndices; iIndex += 3)
+        {
+                for(iCorner = 0; iCorner < 3; iCorner++)
+                {
+                        GLuint iA = rsMesh.indices[iIndex + iCorner];
+                        GLuint iB = rsMesh.indices[iIndex + (iCorner + 1) % 3];
+                        if((aiFaces[iA - iFirstVertex] & aiFaces[iB - iFirstVertex]) == 0)
+                                continue;
+
+                        GLuint64 iKey = iA < iB ? ((GLuint64)iA << 32 | iB) : ((GLuint64)iB << 32 | iA);
+                        auto sFound = aiBorderSlot.find(iKey);
+                        if(sFound == aiBorderSlot.end())
+                        {
+                                aiBorderSlot[iKey] = aiBorder.size();
+                                aiBorder.push_back(iA);
+                                aiBorder.push_back(iB);
+                        }
+                        else
+                        {
+                                //shared by two triangles, so it is not on the border
+                                aiBorder[sFound->second] = aiBorder[sFound->second + 1];
+                        }
+                }
+        }
 
-	    // glDeleteVertexArrays(1, &VAO);
-	    // glDeleteBuffers(1, &VBO);
+        //Drop every border vertex fSkirtDepth along its inward normal and join the two rows with a quad per edge
+        std::vector<GLint> aiSkirtVertex(iNumOfVertices - iFirstVertex, -1);
+        auto iSkirtVertex = [&](GLuint iTop) -> GLuint
+        {
+                GLint &riSkirt = aiSkirtVertex[iTop - iFirstVertex];
+                if(riSkirt < 0)
+                {
+                        riSkirt = (GLint)rsMesh.iNumOfVertices();
+                        for(GLint iComponent = 0; iComponent < iStride; iComponent++)
+                        {
+                                rsMesh.vertices.push_back(rsMesh.vertices[(size_t)iTop * iStride + iComponent]);
+                        }
+                        GLfloat *pfSkirt = &rsMesh.vertices[(size_t)riSkirt * iStride];
+                        pfSkirt[0] -= pfSkirt[3] * fSkirtDepth;
+                        pfSkirt[1] -= pfSkirt[4] * fSkirtDepth;
+                        pfSkirt[2] -= pfSkirt[5] * fSkirtDepth;
+                }
+                return (GLuint)riSkirt;
+        };
+        for(iIndex = 0; iIndex < aiBorder.size(); iIndex += 2)
+        {
+                GLuint iA = aiBorder[iIndex];
+                GLuint iB = aiBorder[iIndex + 1];
+                if(iA == iB)
+                        continue;
+
+                GLuint iSkirtA = iSkirtVertex(iA);
+                GLuint iSkirtB = iSkirtVertex(iB);
+                rsMesh.indices.push_back(iB);
+                rsMesh.indices.push_back(iA);
+                rsMesh.indices.push_back(iSkirtA);
+                rsMesh.indices.push_back(iB);
+                rsMesh.indices.push_back(iSkirtA);
+                rsMesh.indices.push_back(iSkirtB);
+        }
 }
 
 
@@ -1,14 +1,226 @@
 #pragma once
+#ifdef MC_HEADLESS
+//Built without a GL loader (bench/mc_bench): the mesher only needs GL's scalar types and two enums
+#include <cstdint>
+typedef void          GLvoid;
+typedef unsigned char GLboolean;
+typedef unsigned char GLubyte;
+typedef int           GLint;
+typedef unsigned int  GLuint;
+typedef uint64_t      GLuint64;
+typedef unsigned int  GLenum;
+typedef float         GLfloat;
+typedef double        GLdouble;
+#define GL_UNSIGNED_SHORT 0x1403
+#define GL_UNSIGNED_INT   0x1405
+#else
 #include <glad/glad.h>
+#endif
+
+#include <functional>
+#include <vector>
+
+#include "workerpool.h"
+
+struct GLvector
+{
+        GLfloat fX;
+        GLfloat fY;
+        GLfloat fZ;
+};
 
 GLvoid vSetTime(GLfloat fTime);
+// the seed of the noise fSample4 and fSample5 are made of, 0 unless set. Like vSetTime(), only change it while no
+// mesher of them runs
+GLvoid vSetSeed(GLuint iSeed);
+GLuint iGetSeed();
 GLfloat fSample1(GLfloat fX, GLfloat fY, GLfloat fZ);
 GLfloat fSample2(GLfloat fX, GLfloat fY, GLfloat fZ);
 GLfloat fSample3(GLfloat fX, GLfloat fY, GLfloat fZ);
 GLfloat fSample4(GLfloat fX, GLfloat fY, GLfloat fZ);
-extern GLfloat (*fSample)(GLfloat fX, GLfloat fY, GLfloat fZ);
+GLfloat fSample5(GLfloat fX, GLfloat fY, GLfloat fZ);
+GLfloat fSampleGraph(GLfloat fX, GLfloat fY, GLfloat fZ);
+
+// the compiled density graph fSampleGraph evaluates (see densitygraph.h). The program has to outlive every mesher
+// of fSampleGraph, and may only be changed while none runs, like vSetTime()
+class DensityProgram;
+GLvoid vSetSampleGraph(const DensityProgram *pProgram);
+
+// A density source is any scalar field over world space; fSample1..5 and fSampleGraph all qualify
+typedef GLfloat (*DensityFunction)(GLfloat fX, GLfloat fY, GLfloat fZ);
+
+// the density source currently selected with F7
+extern DensityFunction fSample;
+
+// Lattice form of a density source: fills pfResult with the iCountX * iCountY * iCountZ points
+// rsOrigin + (iX, iY, iZ) * rsStep, x fastest
+typedef GLvoid (*DensityLatticeFunction)(const GLvector &rsOrigin, const GLvector &rsStep,
+                                         GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult);
+
+GLvoid vSample4Lattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult);
+GLvoid vSample5Lattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult);
+GLvoid vSampleGraphLattice(const GLvector &rsOrigin, const GLvector &rsStep, GLint iCountX, GLint iCountY, GLint iCountZ, GLfloat *pfResult);
+
+// the lattice form of fDensity, or nullptr if it only evaluates one point per call
+DensityLatticeFunction fGetSampleLattice(DensityFunction fDensity);
+
+// Gradient form of a density source: the density's derivatives along x, y and z at (fX, fY, fZ)
+typedef GLvoid (*DensityGradientFunction)(GLfloat fX, GLfloat fY, GLfloat fZ, GLvector &rsGradient);
+
+GLvoid vSample4Gradient(GLfloat fX, GLfloat fY, GLfloat fZ, GLvector &rsGradient);
+GLvoid vSample5Gradient(GLfloat fX, GLfloat fY, GLfloat fZ, GLvector &rsGradient);
+
+// the analytic gradient of fDensity, or nullptr if normals have to come from differences of its samples
+DensityGradientFunction fGetSampleGradient(DensityFunction fDensity);
+
+// a bound on how fast fDensity changes per unit of distance, or 0 if it has none (fSample1 and fSample2 have poles)
+GLfloat fGetSampleLipschitz(DensityFunction fDensity);
+
+// how far the lattice form of fDensity may be from fDensity itself, 0 where it is exact
+GLfloat fGetSampleLatticeError(DensityFunction fDensity);
+
+// Growable output of one meshing run.
+// vertices holds one interleaved position (x, y, z) and normal (nx, ny, nz) per welded surface
+// vertex, indices lists GL_TRIANGLES into it.
+struct MarchingCubesMesh
+{
+        // floats per vertex: position, then normal
+        static const GLint iStride = 6;
+
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint>  indices;
+
+        GLuint iNumOfVertices() const
+        {
+                return (GLuint)(vertices.size() / iStride);
+        }
+
+        // meshes with fewer than 65536 vertices are uploaded with 16 bit indices
+        GLenum eIndexType() const
+        {
+                return iNumOfVertices() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        }
+
+        GLvoid vClear()
+        {
+                vertices.clear();
+                indices.clear();
+        }
+
+        GLuint iNumOfTriangles() const
+        {
+                return (GLuint)(indices.size() / 3);
+        }
+};
+
+// Receives the surface of MarchingCubesMesher::vMeshStream() a batch at a time. The batch's vertices are
+// vertices iFirstVertex on of the whole surface; its indices count from the surface's first vertex
+typedef std::function<void(const MarchingCubesMesh &rsBatch, GLuint iFirstVertex)> MeshBatchSink;
+
+// Default streaming values
+const GLuint MC_STREAM_BATCH_TRIANGLES = 65536;
+const GLint  MC_STREAM_SLAB_CELLS = 16;         // cell layers sampled and marched at a time
+
+// Selects the polygonizer used for each cell
+enum MarchVariant
+{
+        MARCH_CUBES,            // vMarchCube1
+        MARCH_TETRAHEDRA        // vMarchCube2: six tetrahedrons per cell, no ambiguous cases but about three times the triangles
+};
+
+// identifies what fDensity computes across runs: a stable name in rpcName and up to 8 parameters its output
+// depends on in pfParameter (fTime for fSample1..3, the fractal settings for fSample4 and fSample5, the program's
+// hash for fSampleGraph).
+// Returns the number of parameters, or -1 for a source it does not know
+GLint iGetSampleKey(DensityFunction fDensity, const char *&rpcName, GLfloat *pfParameter);
+
+// Extracts the fTargetValue isosurface of a density source inside an axis aligned box.
+// The box is split into iResolution cells along each axis. The mesher keeps no state between
+// calls to vMesh() and writes only to the mesh it is handed, so several meshers (or one mesher
+// from several threads) can run at once.
+class MarchingCubesMesher
+{
+public:
+        MarchingCubesMesher(DensityFunction fDensity, const GLvector &rsMin, const GLvector &rsMax,
+                            GLint iResolution, GLfloat fTargetValue = 0.0f, MarchVariant eVariant = MARCH_CUBES);
+
+        // appends the surface found inside the box to rsMesh
+        GLvoid vMesh(MarchingCubesMesh &rsMesh) const;
+
+        // vMesh in two steps, so the samples can be kept and changed in between.
+        // The grid holds iGridPoints() points along each axis, x fastest, then y, then z; grid point
+        // (iX, iY, iZ) sits at sMin() + (iX - 1, iY - 1, iZ - 1) * sStep(), one point beyond the box on every side.
+        // The grid may no longer be the source's, so vMeshGrid takes normals from it rather than from
+        // fGetSampleGradient() as vMesh does
+        GLvoid vSampleGrid(std::vector<GLfloat> &afGrid) const;
+        GLvoid vMeshGrid(MarchingCubesMesh &rsMesh, const std::vector<GLfloat> &afGrid) const;
+
+        // vMesh for boxes too large to hold at once: the surface goes to vSink in batches of iBatchTriangles
+        // triangles, and only iSlabCells layers of cells are held at a time. Skirts are left out
+        GLvoid vMeshStream(const MeshBatchSink &vSink, GLuint iBatchTriangles = MC_STREAM_BATCH_TRIANGLES,
+                           GLint iSlabCells = MC_STREAM_SLAB_CELLS) const;
+
+        // splits vMesh over the threads of pPool (nullptr meshes on the calling thread only).
+        // The mesh comes out identical for any number of threads
+        GLvoid vSetWorkerPool(WorkerPool *pWorkerPool) { pPool = pWorkerPool; }
+
+        // lets vMesh skip every part of the box where a density that changes by at most fBound per unit
+        // of distance cannot reach fTargetValue (0 samples everything). Defaults to fGetSampleLipschitz()
+        GLvoid vSetLipschitz(GLfloat fBound) { fLipschitz = fBound; }
+
+        // hangs skirts fDepth deep below the surface's border on the box faces (0 turns them off),
+        // see vAddSkirts
+        GLvoid vSetSkirtDepth(GLfloat fDepth) { fSkirtDepth = fDepth; }
+
+        // whether vMesh and vMeshStream take normals from fGetSampleGradient() when the source has one (the default).
+        // They are exact, but cost a little more than one sample per vertex where grid normals come for free
+        GLvoid vSetExactNormals(GLboolean bExact) { bExactNormals = bExact; }
+
+        GLint iResolution() const { return iCells; }
+        const GLvector &sMin() const { return sBoxMin; }
+        const GLvector &sStep() const { return sCellSize; }
+        GLint iGridPoints() const { return iCells + 3; }
+        DensityFunction fSource() const { return fSample; }
+        GLfloat fTarget() const { return fTargetValue; }
+        GLfloat fSkirt() const { return fSkirtDepth; }
+        MarchVariant eMarch() const { return eVariant; }
+        GLboolean bExact() const { return bExactNormals && vSampleGradient != nullptr; }
 
-GLvoid vMarchingCubes(GLuint *VBO, GLuint *VAO, GLuint *numOfTrianglesVariable);
-GLvoid vMarchCube1(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale);
-GLvoid vMarchCube2(GLfloat fX, GLfloat fY, GLfloat fZ, GLfloat fScale);
+private:
+        GLvoid vParallelFor(GLint iCount, const std::function<void(int)> &vTask) const;
+        template <MarchVariant eMarch>
+        GLvoid vMarchGrid(MarchingCubesMesh &rsMesh, GLuint iBaseVertex, const GLfloat *pfGrid,
+                          GLint iFirstCell, GLint iNumOfCells, GLuint *piEdgeVertex, DensityGradientFunction vGradient) const;
+        GLvoid vMarchSlab(MarchingCubesMesh &rsMesh, GLuint iBaseVertex, const GLfloat *pfGrid,
+                          GLint iFirstCell, GLint iNumOfCells, GLuint *piEdgeVertex, DensityGradientFunction vGradient) const;
+        GLvoid vMarchBox(MarchingCubesMesh &rsMesh, const std::vector<GLfloat> &afGrid, DensityGradientFunction vGradient) const;
+        GLboolean bMayHoldSurface(GLfloat &rfCentreValue) const;
+        GLboolean bFindActiveBlocks(std::vector<GLboolean> &abActive, std::vector<GLfloat> &afBlockValue) const;
+        GLvoid vFillDensityGrid(std::vector<GLfloat> &afGrid, const std::vector<GLboolean> &abActive,
+                                const std::vector<GLfloat> &afBlockValue, GLint iFirstPlane, GLint iNumOfPlanes) const;
+        GLvoid vGetGridNormal(GLvector &rfNormal, const GLfloat *pfPoint, GLint iGridPoints) const;
+        GLvoid vMakeEdgeVertex(GLfloat *pfVertex, GLint iX, GLint iY, GLint iZ, GLint iDirection,
+                               const GLfloat *pfLower, GLint iGridPoints, DensityGradientFunction vGradient) const;
+        GLvoid vMarchCube1(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iFlagIndex,
+                           const GLuint *piEdgeVertex) const;
+        GLint  iGetBoxFaces(const GLfloat *pfVertex) const;
+        GLvoid vAddSkirts(MarchingCubesMesh &rsMesh, GLuint iFirstVertex, size_t iFirstIndex) const;
+        GLvoid vMarchCube2(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iFlagIndex,
+                           const GLuint *piEdgeVertex) const;
+        GLvoid vMarchTetrahedron(GLuint *&rpiIndices, GLint iX, GLint iY, GLint iZ, GLint iTetrahedron,
+                                 GLint iTetrahedronIndex, const GLuint *piEdgeVertex) const;
 
+        DensityFunction fSample;
+        DensityLatticeFunction vSampleLattice;
+        DensityGradientFunction vSampleGradient;
+        GLvector        sBoxMin;
+        GLvector        sCellSize;
+        GLint           iCells;
+        GLfloat         fTargetValue;
+        MarchVariant    eVariant;
+        WorkerPool     *pPool;
+        GLfloat         fSkirtDepth;
+        GLfloat         fLipschitz;
+        GLfloat         fLatticeError;
+        GLboolean       bExactNormals;
+};
@@ -0,0 +1,273 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "marchingcubes.h"
+
+// Default cache values
+const char* const MESH_CACHE_DIRECTORY = "terrain_cache";
+const uint32_t MESH_CACHE_MAGIC = 0x4853454Du;     // "MESH"
+const uint32_t MESH_CACHE_VERSION = 6;              // bump whenever the mesher's output changes
+
+// Everything a cached mesh depends on. Keys are compared byte for byte, so makeMeshCacheKey() zeroes the unused parts
+struct MeshCacheKey {
+    uint32_t magic;
+    uint32_t version;
+    char density[16];       // iGetSampleKey() name
+    float parameters[8];    // iGetSampleKey() parameters
+    uint32_t seed;          // iGetSeed()
+    float min[3];
+    float step[3];
+    int32_t resolution;
+    float targetValue;
+    float skirtDepth;
+    int32_t variant;        // MarchVariant
+    int32_t exactNormals;   // bExact()
+};
+
+// A cache file is the header, then vertexCount * MarchingCubesMesh::iStride floats, then indexCount indices of
+// indexType, ready to be handed to glBufferData
+struct MeshCacheHeader {
+    MeshCacheKey key;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+};
+
+// the key of what mesher produces; false if its density source is not one iGetSampleKey() knows
+inline bool makeMeshCacheKey(const MarchingCubesMesher& mesher, MeshCacheKey& key)
+{
+    std::memset(&key, 0, sizeof(key));
+    const char* name;
+    if (iGetSampleKey(mesher.fSource(), name, key.parameters) < 0)
+        return false;
+    key.magic = MESH_CACHE_MAGIC;
+    key.version = MESH_CACHE_VERSION;
+    std::strncpy(key.density, name, sizeof(key.density) - 1);
+    key.seed = iGetSeed();
+    key.min[0] = mesher.sMin().fX;
+    key.min[1] = mesher.sMin().fY;
+    key.min[2] = mesher.sMin().fZ;
+    key.step[0] = mesher.sStep().fX;
+    key.step[1] = mesher.sStep().fY;
+    key.step[2] = mesher.sStep().fZ;
+    key.resolution = mesher.iResolution();
+    key.targetValue = mesher.fTarget();
+    key.skirtDepth = mesher.fSkirt();
+    key.variant = mesher.eMarch();
+    key.exactNormals = mesher.bExact() ? 1 : 0;
+    return true;
+}
+
+// file of key inside directory: a 64 bit FNV-1a hash of the key. Keys that share a hash overwrite each other's file
+inline std::string meshCachePath(const std::string& directory, const MeshCacheKey& key)
+{
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)&key;
+    for (size_t i = 0; i < sizeof(key); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.mesh", (unsigned long long)hash);
+    return directory + name;
+}
+
+inline void makeMeshCacheDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    // returns false if the file cannot be opened or is empty
+    bool Open(const std::string& path)
+    {
+        Close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL)
+            return false;
+        data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (data == nullptr)
+            return false;
+        size = (size_t)fileSize.QuadPart;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat status;
+        void* mapped = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+            mapped = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (const unsigned char*)mapped;
+        size = (size_t)status.st_size;
+#endif
+        return true;
+    }
+
+    void Close()
+    {
+        if (data == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* Data() const
+    {
+        return data;
+    }
+
+    size_t Size() const
+    {
+        return size;
+    }
+
+private:
+    const unsigned char* data{ nullptr };
+    size_t size{ 0 };
+};
+
+// A cache file opened for reading. Vertices() and Indices() point into the mapping and stay valid until Close()
+class CachedMesh
+{
+public:
+    // maps the file of key in directory; false if there is none, or it was written for another key or version
+    bool Open(const std::string& directory, const MeshCacheKey& key)
+    {
+        if (!file.Open(meshCachePath(directory, key)) || file.Size() < sizeof(MeshCacheHeader))
+            return false;
+        header = (const MeshCacheHeader*)file.Data();
+        size_t indexSize = header->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        bool valid = std::memcmp(&header->key, &key, sizeof(key)) == 0
+                     && (header->indexType == GL_UNSIGNED_SHORT || header->indexType == GL_UNSIGNED_INT)
+                     && file.Size() == sizeof(MeshCacheHeader) + VertexBytes() + (size_t)header->indexCount * indexSize;
+        if (!valid)
+            Close();
+        return valid;
+    }
+
+    void Close()
+    {
+        file.Close();
+        header = nullptr;
+    }
+
+    const MeshCacheHeader& Header() const
+    {
+        return *header;
+    }
+
+    const void* Vertices() const
+    {
+        return file.Data() + sizeof(MeshCacheHeader);
+    }
+
+    size_t VertexBytes() const
+    {
+        return (size_t)header->vertexCount * MarchingCubesMesh::iStride * sizeof(GLfloat);
+    }
+
+    const void* Indices() const
+    {
+        return file.Data() + sizeof(MeshCacheHeader) + VertexBytes();
+    }
+
+    size_t IndexBytes() const
+    {
+        return file.Size() - sizeof(MeshCacheHeader) - VertexBytes();
+    }
+
+private:
+    MappedFile file;
+    const MeshCacheHeader* header{ nullptr };
+};
+
+// writes mesh as the file of key in directory. The file is written under a temporary name and renamed into
+// place, so readers never see half of it
+inline bool writeCachedMesh(const std::string& directory, const MeshCacheKey& key, const MarchingCubesMesh& mesh)
+{
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.key = key;
+    header.vertexCount = mesh.iNumOfVertices();
+    header.indexCount = (uint32_t)mesh.indices.size();
+    header.indexType = mesh.eIndexType();
+
+    std::string path = meshCachePath(directory, key);
+    // two writers of one key at once each get their own temporary file
+    std::string partPath = path + "." + std::to_string((uintptr_t)&mesh) + ".part";
+    FILE* file = std::fopen(partPath.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+                   && std::fwrite(mesh.vertices.data(), sizeof(GLfloat), mesh.vertices.size(), file) == mesh.vertices.size();
+    if (header.indexType == GL_UNSIGNED_SHORT)
+    {
+        std::vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+        written = written && std::fwrite(shortIndices.data(), sizeof(GLushort), shortIndices.size(), file) == shortIndices.size();
+    }
+    else
+        written = written && std::fwrite(mesh.indices.data(), sizeof(GLuint), mesh.indices.size(), file) == mesh.indices.size();
+    written = std::fclose(file) == 0 && written;
+
+    // rename() does not replace an existing file everywhere
+    std::remove(path.c_str());
+    if (!written || std::rename(partPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(partPath.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
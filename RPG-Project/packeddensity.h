@@ -0,0 +1,182 @@
+#ifndef PACKEDDENSITY_H
+#define PACKEDDENSITY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Default packing values
+const int DENSITY_BITS = 16;        // 8 or 16 bits per packed sample
+const int DENSITY_BRICK = 8;        // packed grids are split into bricks of this many points along each axis
+const float DENSITY_MU = 255.0f;    // mu-law companding: the larger, the finer the steps near the surface
+
+// Lossy, compact copy of a MarchingCubesMesher::vSampleGrid() grid with its surface at density 0.
+// Samples are clamped to [-range, range] and quantized to 8 or 16 bits. range is the largest density the
+// mesher reads around the surface, the corners of the cells it crosses and their neighbours, so clamping never
+// moves the surface and only quantization is lost. Quantization is mu-law: the steps are finest near density 0,
+// where vertices are placed, so a steep brush in the same chunk does not drown a gentle slope in coarse steps.
+// Away from the surface most samples are clamped, and a brick whose samples all quantize to the same value is
+// stored as that one value
+class PackedDensity
+{
+public:
+    // packs the gridPoints^3 samples of grid at bits (8 or 16) per sample, clamping no tighter than minRange
+    void Pack(const std::vector<GLfloat>& grid, int gridPoints, int bits = DENSITY_BITS, float minRange = 0.0f)
+    {
+        points = gridPoints;
+        largest = bits <= 8 ? INT8_MAX : INT16_MAX;
+        range = std::max(surfaceRange(grid), minRange);
+        if (range <= 0.0f)
+            range = 1.0f;
+        stepsPerLog = largest / std::log(1.0f + DENSITY_MU);
+
+        int bricks = (points + DENSITY_BRICK - 1) / DENSITY_BRICK;
+        size_t numBricks = (size_t)bricks * bricks * bricks;
+        brickValue.assign(numBricks, 0);
+        brickStart.assign(numBricks, UNIFORM);
+        samples8.clear();
+        samples16.clear();
+
+        int values[DENSITY_BRICK * DENSITY_BRICK * DENSITY_BRICK];
+        for (size_t brick = 0; brick < numBricks; brick++)
+        {
+            int count = 0;
+            bool uniform = true;
+            forBrick(brick, [&](size_t point) {
+                values[count] = quantize(grid[point]);
+                uniform = uniform && values[count] == values[0];
+                count++;
+            });
+
+            brickValue[brick] = (int16_t)values[0];
+            if (uniform)
+                continue;
+            if (largest == INT8_MAX)
+            {
+                brickStart[brick] = (uint32_t)samples8.size();
+                samples8.insert(samples8.end(), values, values + count);
+            }
+            else
+            {
+                brickStart[brick] = (uint32_t)samples16.size();
+                samples16.insert(samples16.end(), values, values + count);
+            }
+        }
+        samples8.shrink_to_fit();
+        samples16.shrink_to_fit();
+    }
+
+    // the grid back, every sample on the closest quantization step to the packed one
+    void Unpack(std::vector<GLfloat>& grid) const
+    {
+        grid.resize((size_t)points * points * points);
+        std::vector<float> steps(largest + 1);
+        for (int step = 0; step <= largest; step++)
+            steps[step] = range * (std::exp(step / stepsPerLog) - 1.0f) / DENSITY_MU;
+
+        for (size_t brick = 0; brick < brickStart.size(); brick++)
+        {
+            uint32_t next = brickStart[brick];
+            forBrick(brick, [&](size_t point) {
+                int value = brickValue[brick];
+                if (next != UNIFORM)
+                    value = largest == INT8_MAX ? samples8[next++] : samples16[next++];
+                grid[point] = value < 0 ? -steps[-value] : steps[value];
+            });
+        }
+    }
+
+    bool Empty() const
+    {
+        return points == 0;
+    }
+
+    void Clear()
+    {
+        *this = PackedDensity();
+    }
+
+    // memory held by the packed grid
+    size_t Bytes() const
+    {
+        return sizeof(PackedDensity) + brickValue.capacity() * sizeof(int16_t) + brickStart.capacity() * sizeof(uint32_t)
+               + samples8.capacity() * sizeof(int8_t) + samples16.capacity() * sizeof(int16_t);
+    }
+
+private:
+    enum : uint32_t { UNIFORM = 0xFFFFFFFFu };  // brickStart of a brick without samples
+
+    int points{ 0 };
+    int largest{ INT16_MAX };
+    float range{ 1.0f };
+    float stepsPerLog{ 0.0f };          // quantization steps per unit of log(1 + DENSITY_MU * |value| / range)
+    std::vector<int16_t> brickValue;    // per brick, its value if it is uniform
+    std::vector<uint32_t> brickStart;   // per brick, where its samples start
+    std::vector<int8_t> samples8;
+    std::vector<int16_t> samples16;
+
+    int quantize(float value) const
+    {
+        // most samples are clamped, they skip the logarithm
+        int quantized = largest;
+        if (std::fabs(value) < range)
+            quantized = (int)(std::log(1.0f + DENSITY_MU * std::fabs(value) / range) * stepsPerLog + 0.5f);
+        if (value < 0.0f)
+            quantized = -quantized;
+        // a sample just above the surface must stay above it
+        if (value > 0.0f && quantized <= 0)
+            quantized = 1;
+        return quantized;
+    }
+
+    // calls visit with the grid index of every point of brick, x fastest
+    template <typename Visit>
+    void forBrick(size_t brick, Visit visit) const
+    {
+        int bricks = (points + DENSITY_BRICK - 1) / DENSITY_BRICK;
+        int x0 = (int)(brick % bricks) * DENSITY_BRICK;
+        int y0 = (int)(brick / bricks % bricks) * DENSITY_BRICK;
+        int z0 = (int)(brick / bricks / bricks) * DENSITY_BRICK;
+        for (int z = z0; z < std::min(z0 + DENSITY_BRICK, points); z++)
+            for (int y = y0; y < std::min(y0 + DENSITY_BRICK, points); y++)
+                for (int x = x0; x < std::min(x0 + DENSITY_BRICK, points); x++)
+                    visit(((size_t)z * points + y) * points + x);
+    }
+
+    // the largest magnitude among the corners of cells the surface crosses and their 6 neighbours. The cube and
+    // tetrahedra variants only place vertices on edges and face or body diagonals inside such cells, and take
+    // their normals from the neighbours of those corners, so this is every sample the mesher reads there
+    float surfaceRange(const std::vector<GLfloat>& grid) const
+    {
+        const size_t step[3] = { 1, (size_t)points, (size_t)points * points };
+        float result = 0.0f;
+        auto widen = [&](int x, int y, int z) {
+            size_t point = ((size_t)z * points + y) * points + x;
+            result = std::max(result, std::fabs(grid[point]));
+            if (x > 0) result = std::max(result, std::fabs(grid[point - step[0]]));
+            if (x < points - 1) result = std::max(result, std::fabs(grid[point + step[0]]));
+            if (y > 0) result = std::max(result, std::fabs(grid[point - step[1]]));
+            if (y < points - 1) result = std::max(result, std::fabs(grid[point + step[1]]));
+            if (z > 0) result = std::max(result, std::fabs(grid[point - step[2]]));
+            if (z < points - 1) result = std::max(result, std::fabs(grid[point + step[2]]));
+        };
+        for (int z = 0; z < points - 1; z++)
+            for (int y = 0; y < points - 1; y++)
+                for (int x = 0; x < points - 1; x++)
+                {
+                    size_t point = ((size_t)z * points + y) * points + x;
+                    int above = 0;
+                    for (int corner = 0; corner < 8; corner++)
+                        above += grid[point + (corner & 1) * step[0] + (corner >> 1 & 1) * step[1] + (corner >> 2) * step[2]] > 0.0f;
+                    if (above == 0 || above == 8)
+                        continue;
+                    for (int corner = 0; corner < 8; corner++)
+                        widen(x + (corner & 1), y + (corner >> 1 & 1), z + (corner >> 2));
+                }
+        return result;
+    }
+};
+#endif
@@ -0,0 +1,742 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "densityedits.h"
+#include "lockfreequeue.h"
+#include "marchingcubes.h"
+#include "meshcache.h"
+#include "packeddensity.h"
+#include "workerpool.h"
+
+// Default terrain values
+const float CHUNK_SIZE = 1.0f;      // world units covered by a finest level chunk along each axis
+const int CHUNK_RESOLUTION = 32;    // marching cubes cells along each axis of a chunk, at every level
+const int LOD_LEVELS = 4;           // chunk size and cell size double with every level
+const float LOD_DISTANCE = 0.5f;    // a chunk closer to the viewer than this many of its own sizes is split into 8
+const int VIEW_RADIUS = 2;          // in chunks of the coarsest level
+const float UPLOAD_BUDGET_MS = 2.0f; // time per frame spent uploading finished chunks
+const size_t DENSITY_BUDGET = 32u << 20; // bytes of packed density kept for edited chunks
+
+// Integer position and level of a chunk; chunk (x, y, z, lod) covers [x, x + 1) * CHUNK_SIZE * 2^lod along x, and so on.
+// The 8 chunks (2x..2x+1, 2y..2y+1, 2z..2z+1, lod - 1) exactly cover chunk (x, y, z, lod)
+struct ChunkCoord {
+    int x;
+    int y;
+    int z;
+    int lod;
+
+    bool operator==(const ChunkCoord& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && lod == other.lod;
+    }
+
+    // whether one of the two chunks lies inside the other
+    bool Overlaps(const ChunkCoord& other) const
+    {
+        if (lod > other.lod)
+            return other.Overlaps(*this);
+        int shift = other.lod - lod;
+        return (x >> shift) == other.x && (y >> shift) == other.y && (z >> shift) == other.z;
+    }
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord& coord) const
+    {
+        // large primes spread neighbouring chunks over the buckets
+        return (size_t)((unsigned int)coord.x * 73856093u ^ (unsigned int)coord.y * 19349663u ^ (unsigned int)coord.z * 83492791u
+                        ^ (unsigned int)coord.lod * 2654435761u);
+    }
+};
+
+// GPU side of one meshed chunk. Empty chunks keep no buffers but are still remembered so they are not meshed again
+struct TerrainChunk {
+    unsigned int VAO{ 0 };
+    unsigned int VBO{ 0 };
+    unsigned int EBO{ 0 };
+    GLsizei indexCount{ 0 };
+    GLenum indexType{ GL_UNSIGNED_INT };
+    GLsizeiptr vertexBytes{ 0 };    // allocated size of VBO and EBO
+    GLsizeiptr indexBytes{ 0 };
+};
+
+// writes data into buffer, reallocating it only when data does not fit in the bytes allocated so far
+inline void writeTerrainBuffer(GLenum target, const void* data, GLsizeiptr size, GLsizeiptr& allocated)
+{
+    if (size > allocated)
+    {
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+        allocated = size;
+    }
+    else
+        glBufferSubData(target, 0, size, data);
+}
+
+// uploads interleaved MarchingCubesMesh vertices and indexCount indices of indexType into the chunk's VAO and its
+// vertex and element buffers, creating them the first time. A chunk that is uploaded again after an edit
+// overwrites its buffers in place as long as the new mesh fits
+inline void uploadTerrainData(const void* vertices, GLsizeiptr vertexBytes, const void* indices, GLsizei indexCount,
+                              GLenum indexType, TerrainChunk& chunk)
+{
+    chunk.indexCount = indexCount;
+    chunk.indexType = indexType;
+    if (chunk.indexCount == 0)
+        return;
+
+    bool created = chunk.VAO == 0;
+    if (created)
+    {
+        glGenVertexArrays(1, &chunk.VAO);
+        glGenBuffers(1, &chunk.VBO);
+        glGenBuffers(1, &chunk.EBO);
+    }
+
+    glBindVertexArray(chunk.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+    writeTerrainBuffer(GL_ARRAY_BUFFER, vertices, vertexBytes, chunk.vertexBytes);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.EBO);
+    GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    writeTerrainBuffer(GL_ELEMENT_ARRAY_BUFFER, indices, indexCount * indexSize, chunk.indexBytes);
+
+    if (created)
+    {
+        GLuint stride{ MarchingCubesMesh::iStride };
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+
+    glBindVertexArray(0);
+}
+
+// uploads a marching cubes mesh with uploadTerrainData, the element buffer uses mesh.eIndexType() sized indices
+inline void uploadTerrainMesh(const MarchingCubesMesh& mesh, TerrainChunk& chunk)
+{
+    GLsizeiptr vertexBytes = mesh.vertices.size() * sizeof(GLfloat);
+    if (mesh.eIndexType() == GL_UNSIGNED_SHORT)
+    {
+        // small meshes (a single chunk usually is one) get half-size indices
+        std::vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+        uploadTerrainData(mesh.vertices.data(), vertexBytes, shortIndices.data(), (GLsizei)shortIndices.size(), GL_UNSIGNED_SHORT, chunk);
+    }
+    else
+        uploadTerrainData(mesh.vertices.data(), vertexBytes, mesh.indices.data(), (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, chunk);
+}
+
+inline void deleteTerrainChunk(TerrainChunk& chunk)
+{
+    if (chunk.VAO == 0)
+        return;
+    glDeleteVertexArrays(1, &chunk.VAO);
+    glDeleteBuffers(1, &chunk.VBO);
+    glDeleteBuffers(1, &chunk.EBO);
+    chunk = TerrainChunk();
+}
+
+// Keeps the terrain around the viewer meshed and uploaded, and frees the chunks that are no longer needed.
+// The terrain is an octree of chunks: the coarsest level covers ViewRadius chunks around the viewer and every
+// chunk nearer than LodDistance of its own sizes is replaced by its 8 children, down to level 0. All chunks
+// have the same number of cells, so the triangle count grows with the number of levels rather than with the
+// view distance. Every chunk carries skirts two of its cells deep that hide the cracks where levels meet.
+// Chunks are generated and meshed on background threads. Finished CPU meshes come back through a lock-free
+// queue and Update() uploads them under a per-frame time budget, so the render loop never waits on meshing.
+// Edit() changes the density with brushes. The density is the source plus the list of brushes, so a chunk no edit
+// reaches stores nothing and any chunk can be rebuilt by sampling it and replaying the brushes that reach it.
+// Recently edited chunks also keep their samples as a PackedDensity, so the next edit there only has to rework the
+// grid points inside its brush before the chunk is marched and uploaded again. Packed samples stay within
+// DensityBudget bytes, the least recently edited chunks give theirs up first.
+// Chunks no edit reaches are also written to a MeshCache file in CacheDirectory once meshed. Update() maps the
+// files of the chunks it needs and uploads them straight from the mapping, so a warm start meshes nothing.
+// All methods must be called from the thread that owns the GL context
+class ChunkManager
+{
+public:
+    float ChunkSize;
+    int ChunkResolution;
+    int LodLevels;
+    float LodDistance;
+    int ViewRadius;
+    int MaxPendingChunks;       // chunks queued or being meshed at once, nearest ones are requested first
+    float UploadBudgetMs;       // time Update() may spend uploading finished chunks each frame
+    size_t DensityBudget;       // bytes of packed density kept for edited chunks
+    int DensityBits;            // 8 or 16 bits per packed sample
+    std::string CacheDirectory; // where chunk meshes are cached between runs, empty turns the cache off
+
+    // constructor, chunks are meshed with density on numThreads background threads
+    ChunkManager(DensityFunction density, unsigned int numThreads = WorkerPool::DefaultThreads(), float chunkSize = CHUNK_SIZE,
+                 int chunkResolution = CHUNK_RESOLUTION, int viewRadius = VIEW_RADIUS)
+        : ChunkSize(chunkSize), ChunkResolution(chunkResolution), LodLevels(LOD_LEVELS), LodDistance(LOD_DISTANCE),
+          ViewRadius(viewRadius), UploadBudgetMs(UPLOAD_BUDGET_MS), DensityBudget(DENSITY_BUDGET), DensityBits(DENSITY_BITS),
+          CacheDirectory(MESH_CACHE_DIRECTORY), density(density)
+    {
+        if (numThreads == 0)
+            numThreads = 1;
+        MaxPendingChunks = 2 * (int)numThreads;
+        for (unsigned int i = 0; i < numThreads; i++)
+            workers.emplace_back(&ChunkManager::workerLoop, this);
+    }
+
+    ~ChunkManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            quit = true;
+        }
+        jobReady.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+
+        ChunkMeshResult* result;
+        while (finished.TryPop(result))
+            delete result;
+        Clear();
+    }
+
+    ChunkManager(const ChunkManager&) = delete;
+    ChunkManager& operator=(const ChunkManager&) = delete;
+
+    // switches to another density source; every chunk is meshed again, with the edits made so far
+    void SetDensity(DensityFunction newDensity)
+    {
+        if (newDensity == density)
+            return;
+        density = newDensity;
+        Clear();
+    }
+
+    // switches to another polygonizer; every chunk is meshed again
+    void SetVariant(MarchVariant newVariant)
+    {
+        if (newVariant == variant)
+            return;
+        variant = newVariant;
+        Clear();
+    }
+
+    // uploads finished chunks until UploadBudgetMs runs out, works out which chunks the view from position needs,
+    // frees the others, loads the missing ones that are cached with what is left of the budget and requests the
+    // rest, nearest first.
+    // A chunk that is no longer needed stays until every needed chunk overlapping it is uploaded, so switching
+    // levels never opens a hole
+    void Update(const glm::vec3& position)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uploadFinished(start);
+
+        std::vector<ChunkCoord> selected;
+        selectChunks(position, selected);
+        std::unordered_set<ChunkCoord, ChunkCoordHash> needed;
+        std::vector<ChunkCoord> notReady;
+        for (const ChunkCoord& coord : selected)
+        {
+            needed.insert(coord);
+            auto it = chunks.find(coord);
+            if (it == chunks.end() || it->second.ticket != 0)
+                notReady.push_back(coord);
+        }
+
+        for (auto it = chunks.begin(); it != chunks.end();)
+        {
+            bool keep = needed.count(it->first) != 0;
+            if (!keep && it->second.ticket == 0)
+            {
+                for (const ChunkCoord& coord : notReady)
+                    if (coord.Overlaps(it->first))
+                    {
+                        keep = true;
+                        break;
+                    }
+            }
+
+            if (!keep)
+            {
+                // a result still in flight for it no longer matches any chunk and is dropped on arrival
+                if (it->second.ticket != 0)
+                    pendingChunks--;
+                deleteTerrainChunk(it->second.gpu);
+                it = chunks.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        {
+            // requests for chunks that are not needed anymore are not worth meshing
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [this](const ChunkJob& job) {
+                auto it = chunks.find(job.coord);
+                return it == chunks.end() || it->second.ticket != job.ticket;
+            }), jobs.end());
+        }
+
+        std::vector<ChunkCoord> missing;
+        for (const ChunkCoord& coord : notReady)
+            if (chunks.find(coord) == chunks.end())
+                missing.push_back(coord);
+
+        std::sort(missing.begin(), missing.end(), [&](const ChunkCoord& a, const ChunkCoord& b) {
+            return distanceTo(a, position) < distanceTo(b, position);
+        });
+        if (!CacheDirectory.empty())
+            loadCached(missing, start);
+
+        if (pendingChunks >= MaxPendingChunks)
+            return;
+        if ((int)missing.size() > MaxPendingChunks - pendingChunks)
+            missing.resize(MaxPendingChunks - pendingChunks);
+
+        if (missing.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            for (const ChunkCoord& coord : missing)
+            {
+                ChunkJob job{ coord, density, variant, ++lastTicket };
+                collectBrushes(coord, job.brushes);
+                if (job.brushes.empty())
+                    job.cacheDirectory = CacheDirectory;
+                chunks[coord].ticket = job.ticket;
+                jobs.push_back(job);
+                pendingChunks++;
+            }
+        }
+        jobReady.notify_all();
+    }
+
+    // applies brush to the density and brings every chunk it reaches up to date before returning, so the edit
+    // shows in the next Draw(). Chunks still waiting for their mesh are requested again, ahead of the others
+    void Edit(const DensityBrush& brush)
+    {
+        brushes.push_back(brush);
+        strongestBrush = std::max(strongestBrush, brush.Strength);
+        glm::vec3 min, max;
+        brush.Bounds(min, max);
+
+        bool requested = false;
+        for (auto& entry : chunks)
+        {
+            const ChunkCoord& coord = entry.first;
+            ChunkEntry& chunk = entry.second;
+            if (!reaches(coord, min, max))
+                continue;
+
+            if (chunk.ticket != 0)
+            {
+                ChunkJob job{ coord, density, variant, ++lastTicket };
+                collectBrushes(coord, job.brushes);
+                chunk.ticket = job.ticket;
+                std::lock_guard<std::mutex> lock(jobMutex);
+                jobs.push_front(job);
+                requested = true;
+                continue;
+            }
+
+            MarchingCubesMesher mesher = makeMesher(coord, density, variant);
+            std::vector<GLfloat> grid;
+            if (chunk.density.Empty())
+            {
+                // no samples kept: the source with every brush that reaches the chunk
+                mesher.vSampleGrid(grid);
+                std::vector<DensityBrush> reaching;
+                collectBrushes(coord, reaching);
+                for (const DensityBrush& other : reaching)
+                    applyBrush(other, grid, mesher);
+            }
+            else
+            {
+                chunk.density.Unpack(grid);
+                applyBrush(brush, grid, mesher);
+            }
+
+            MarchingCubesMesh mesh;
+            mesher.vMeshGrid(mesh, grid);
+            uploadTerrainMesh(mesh, chunk.gpu);
+
+            // later brushes may carve next to clamped samples, they must read their own slope there
+            float cell = SizeOf(coord.lod) / ChunkResolution;
+            chunk.density.Pack(grid, mesher.iGridPoints(), DensityBits, 2.0f * cell * strongestBrush);
+            chunk.lastEdit = brushes.size();
+        }
+        if (requested)
+            jobReady.notify_all();
+        trimDensity();
+    }
+
+    // forgets every edit; chunks are meshed again from the density source alone
+    void ClearEdits()
+    {
+        brushes.clear();
+        Clear();
+    }
+
+    size_t NumEdits() const
+    {
+        return brushes.size();
+    }
+
+    // bytes of packed density chunk keeps, 0 if it keeps none
+    size_t ChunkDensityBytes(const ChunkCoord& coord) const
+    {
+        auto it = chunks.find(coord);
+        return it == chunks.end() || it->second.density.Empty() ? 0 : it->second.density.Bytes();
+    }
+
+    // bytes held by the edits: every packed chunk density and the brush list
+    size_t DensityBytes() const
+    {
+        size_t bytes = brushes.capacity() * sizeof(DensityBrush);
+        for (const auto& entry : chunks)
+            bytes += ChunkDensityBytes(entry.first);
+        return bytes;
+    }
+
+    // draws every uploaded, non-empty chunk with the currently bound shader
+    void Draw() const
+    {
+        for (const auto& entry : chunks)
+        {
+            const TerrainChunk& chunk = entry.second.gpu;
+            if (chunk.indexCount == 0)
+                continue;
+            glBindVertexArray(chunk.VAO);
+            glDrawElements(GL_TRIANGLES, chunk.indexCount, chunk.indexType, 0);
+        }
+        glBindVertexArray(0);
+    }
+
+    // frees every chunk and forgets the requests that have not started yet
+    void Clear()
+    {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobs.clear();
+        }
+        for (auto& entry : chunks)
+            deleteTerrainChunk(entry.second.gpu);
+        chunks.clear();
+        cacheMisses.clear();
+        pendingChunks = 0;
+    }
+
+    // waits until no worker is meshing. With Clear() first nothing is left to start either, so the globals the
+    // density sources read (vSetTime(), vSetSeed()) may then change
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        workersIdle.wait(lock, [this] { return busyWorkers == 0; });
+    }
+
+    // the chunk of level lod that contains position
+    ChunkCoord ChunkAt(const glm::vec3& position, int lod = 0) const
+    {
+        float size = SizeOf(lod);
+        return ChunkCoord{ (int)std::floor(position.x / size), (int)std::floor(position.y / size), (int)std::floor(position.z / size), lod };
+    }
+
+    // world units covered by a chunk of level lod along each axis
+    float SizeOf(int lod) const
+    {
+        return ChunkSize * (float)(1 << lod);
+    }
+
+    size_t NumChunks() const
+    {
+        return chunks.size();
+    }
+
+    // chunks requested but not uploaded yet
+    int NumPendingChunks() const
+    {
+        return pendingChunks;
+    }
+
+private:
+    // what a worker needs to mesh one chunk; ticket tells a result apart from older requests for the same chunk
+    struct ChunkJob {
+        ChunkCoord coord;
+        DensityFunction density;
+        MarchVariant variant;
+        unsigned long ticket;
+        std::vector<DensityBrush> brushes;  // the edits that reach the chunk, in the order they were made
+        std::string cacheDirectory;         // where to cache the mesh, empty if it is not cached
+    };
+
+    struct ChunkMeshResult {
+        ChunkCoord coord;
+        unsigned long ticket;
+        MarchingCubesMesh mesh;
+    };
+
+    struct ChunkEntry {
+        TerrainChunk gpu;
+        unsigned long ticket{ 0 };  // non-zero while the chunk waits for its mesh
+        PackedDensity density;      // vSampleGrid() samples with the edits applied, empty if not kept
+        size_t lastEdit{ 0 };       // NumEdits() when density was packed
+    };
+
+    DensityFunction density;
+    MarchVariant variant{ MARCH_CUBES };
+    std::unordered_set<ChunkCoord, ChunkCoordHash> cacheMisses;    // chunks without a cache file, not looked up again
+    std::vector<DensityBrush> brushes;
+    float strongestBrush{ 0.0f };
+    std::unordered_map<ChunkCoord, ChunkEntry, ChunkCoordHash> chunks;
+    int pendingChunks{ 0 };
+    unsigned long lastTicket{ 0 };
+
+    // background meshing
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<ChunkJob> jobs;
+    int busyWorkers{ 0 };       // workers between taking a job and finishing its mesh, guarded by jobMutex
+    std::condition_variable workersIdle;
+    std::atomic<bool> quit{ false };
+    LockFreeQueue<ChunkMeshResult*> finished;
+
+    static int distanceSquared(const ChunkCoord& a, const ChunkCoord& b)
+    {
+        int x = a.x - b.x, y = a.y - b.y, z = a.z - b.z;
+        return x * x + y * y + z * z;
+    }
+
+    bool inRange(const ChunkCoord& coord, const ChunkCoord& center) const
+    {
+        return distanceSquared(coord, center) <= ViewRadius * ViewRadius;
+    }
+
+    // distance from position to the nearest point of the chunk
+    float distanceTo(const ChunkCoord& coord, const glm::vec3& position) const
+    {
+        float size = SizeOf(coord.lod);
+        float x = std::max(std::max(coord.x * size - position.x, position.x - (coord.x + 1) * size), 0.0f);
+        float y = std::max(std::max(coord.y * size - position.y, position.y - (coord.y + 1) * size), 0.0f);
+        float z = std::max(std::max(coord.z * size - position.z, position.z - (coord.z + 1) * size), 0.0f);
+        return std::sqrt(x * x + y * y + z * z);
+    }
+
+    // the mesher of a chunk, the same for background and edit meshing
+    MarchingCubesMesher makeMesher(const ChunkCoord& coord, DensityFunction source, MarchVariant march) const
+    {
+        float size = SizeOf(coord.lod);
+        GLvector chunkMin{ coord.x * size, coord.y * size, coord.z * size };
+        GLvector chunkMax{ chunkMin.fX + size, chunkMin.fY + size, chunkMin.fZ + size };
+        MarchingCubesMesher mesher(source, chunkMin, chunkMax, ChunkResolution, 0.0f, march);
+        mesher.vSetSkirtDepth(2.0f * size / ChunkResolution);
+        return mesher;
+    }
+
+    // whether the box from min to max reaches a sample of the chunk: the chunk grows by the one cell of samples
+    // around it that its normals read
+    bool reaches(const ChunkCoord& coord, const glm::vec3& min, const glm::vec3& max) const
+    {
+        float size = SizeOf(coord.lod);
+        float cell = size / ChunkResolution;
+        glm::vec3 chunkMin = glm::vec3(coord.x, coord.y, coord.z) * size - cell;
+        glm::vec3 chunkMax = chunkMin + size + 2.0f * cell;
+        return min.x <= chunkMax.x && max.x >= chunkMin.x && min.y <= chunkMax.y && max.y >= chunkMin.y
+            && min.z <= chunkMax.z && max.z >= chunkMin.z;
+    }
+
+    void collectBrushes(const ChunkCoord& coord, std::vector<DensityBrush>& reaching) const
+    {
+        for (const DensityBrush& brush : brushes)
+        {
+            glm::vec3 min, max;
+            brush.Bounds(min, max);
+            if (reaches(coord, min, max))
+                reaching.push_back(brush);
+        }
+    }
+
+    // collects the leaves of the chunk octree around position
+    void selectChunks(const glm::vec3& position, std::vector<ChunkCoord>& selected) const
+    {
+        int top = LodLevels - 1;
+        ChunkCoord center = ChunkAt(position, top);
+        for (int z = -ViewRadius; z <= ViewRadius; z++)
+            for (int y = -ViewRadius; y <= ViewRadius; y++)
+                for (int x = -ViewRadius; x <= ViewRadius; x++)
+                {
+                    ChunkCoord coord{ center.x + x, center.y + y, center.z + z, top };
+                    if (inRange(coord, center))
+                        refine(coord, position, selected);
+                }
+    }
+
+    void refine(const ChunkCoord& node, const glm::vec3& position, std::vector<ChunkCoord>& selected) const
+    {
+        if (node.lod == 0 || distanceTo(node, position) >= LodDistance * SizeOf(node.lod))
+        {
+            selected.push_back(node);
+            return;
+        }
+        for (int child = 0; child < 8; child++)
+        {
+            ChunkCoord coord{ 2 * node.x + (child & 1), 2 * node.y + ((child >> 1) & 1), 2 * node.z + (child >> 2), node.lod - 1 };
+            refine(coord, position, selected);
+        }
+    }
+
+    // drops the packed density of the least recently edited chunks until the rest fits in DensityBudget;
+    // their next edit samples them again
+    void trimDensity()
+    {
+        size_t bytes = DensityBytes();
+        while (bytes > DensityBudget)
+        {
+            ChunkEntry* oldest = nullptr;
+            for (auto& entry : chunks)
+                if (!entry.second.density.Empty() && (!oldest || entry.second.lastEdit < oldest->lastEdit))
+                    oldest = &entry.second;
+            if (!oldest)
+                return;
+            bytes -= oldest->density.Bytes();
+            oldest->density.Clear();
+        }
+    }
+
+    // uploads the chunks of missing that have a cache file from their mapping until the upload budget that started
+    // at start runs out. Only the chunks that have to be meshed are left in missing: the ones that may be cached but
+    // did not fit in the budget wait for the next frame
+    void loadCached(std::vector<ChunkCoord>& missing, std::chrono::steady_clock::time_point start)
+    {
+        auto next = missing.begin();
+        for (auto it = missing.begin(); it != missing.end(); ++it)
+        {
+            if (!mayBeCached(*it))
+            {
+                *next++ = *it;
+                continue;
+            }
+            std::chrono::duration<float, std::milli> spent = std::chrono::steady_clock::now() - start;
+            if (spent.count() < UploadBudgetMs && !tryLoadCached(*it))
+                *next++ = *it;
+        }
+        missing.erase(next, missing.end());
+    }
+
+    bool mayBeCached(const ChunkCoord& coord) const
+    {
+        std::vector<DensityBrush> reaching;
+        collectBrushes(coord, reaching);
+        return reaching.empty() && !cacheMisses.count(coord);
+    }
+
+    // false if coord has to be meshed
+    bool tryLoadCached(const ChunkCoord& coord)
+    {
+        MeshCacheKey key;
+        if (!makeMeshCacheKey(makeMesher(coord, density, variant), key))
+        {
+            cacheMisses.insert(coord);
+            return false;
+        }
+
+        CachedMesh cached;
+        if (!cached.Open(CacheDirectory, key))
+        {
+            cacheMisses.insert(coord);
+            return false;
+        }
+        const MeshCacheHeader& header = cached.Header();
+        uploadTerrainData(cached.Vertices(), cached.VertexBytes(), cached.Indices(), header.indexCount, header.indexType,
+                          chunks[coord].gpu);
+        return true;
+    }
+
+    void uploadFinished(std::chrono::steady_clock::time_point start)
+    {
+        ChunkMeshResult* result;
+        while (finished.TryPop(result))
+        {
+            auto it = chunks.find(result->coord);
+            if (it != chunks.end() && it->second.ticket == result->ticket)
+            {
+                uploadTerrainMesh(result->mesh, it->second.gpu);
+                it->second.ticket = 0;
+                cacheMisses.erase(result->coord);
+                pendingChunks--;
+            }
+            delete result;
+
+            std::chrono::duration<float, std::milli> spent = std::chrono::steady_clock::now() - start;
+            if (spent.count() >= UploadBudgetMs)
+                break;
+        }
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            ChunkJob job;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobReady.wait(lock, [this] { return quit || !jobs.empty(); });
+                if (quit)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+                busyWorkers++;
+            }
+
+            // the key is made along with the samples, while the globals it records are the ones they are taken at
+            MarchingCubesMesher mesher = makeMesher(job.coord, job.density, job.variant);
+            MeshCacheKey key;
+            bool cache = !job.cacheDirectory.empty() && makeMeshCacheKey(mesher, key);
+            ChunkMeshResult* result = new ChunkMeshResult{ job.coord, job.ticket, MarchingCubesMesh() };
+            if (job.brushes.empty())
+                mesher.vMesh(result->mesh);
+            else
+            {
+                std::vector<GLfloat> grid;
+                mesher.vSampleGrid(grid);
+                for (const DensityBrush& brush : job.brushes)
+                    applyBrush(brush, grid, mesher);
+                mesher.vMeshGrid(result->mesh, grid);
+            }
+
+            if (cache)
+            {
+                makeMeshCacheDirectory(job.cacheDirectory);
+                writeCachedMesh(job.cacheDirectory, key, result->mesh);
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                busyWorkers--;
+            }
+            workersIdle.notify_all();
+
+            // the GL thread drains the queue every frame, so it is only ever full for a moment
+            while (!finished.TryPush(result))
+            {
+                if (quit)
+                {
+                    delete result;
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,141 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run the iterations of a parallel loop.
+// The calling thread works on the loop too, so a pool of N threads keeps N + 1 cores busy.
+// ParallelFor must not be called from inside one of its own tasks.
+class WorkerPool
+{
+public:
+    // constructor, numThreads extra threads are started (0 runs every loop on the calling thread)
+    explicit WorkerPool(unsigned int numThreads = DefaultThreads())
+    {
+        for (unsigned int i = 0; i < numThreads; i++)
+            threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // one worker per core, leaving one core to the calling thread
+    static unsigned int DefaultThreads()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    // number of threads that take part in a loop, the caller included
+    unsigned int NumThreads() const
+    {
+        return (unsigned int)threads.size() + 1;
+    }
+
+    // runs task(i) for every i in [0, count) and returns once all of them finished.
+    // Iterations are handed out one at a time, so any i may run on any thread.
+    void ParallelFor(int count, const std::function<void(int)>& task)
+    {
+        if (count <= 0)
+            return;
+        if (threads.empty() || count == 1)
+        {
+            for (int i = 0; i < count; i++)
+                task(i);
+            return;
+        }
+
+        // one loop at a time; other callers wait their turn
+        std::lock_guard<std::mutex> loopLock(loopMutex);
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            currentTask = &task;
+            taskCount = count;
+            nextIndex = 0;
+            unfinished = count;
+            generation++;
+        }
+        wake.notify_all();
+
+        int finished = runIterations(task, count);
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        unfinished -= finished;
+        // wait for the workers to leave the loop too, so none of them can touch task after we return
+        done.wait(lock, [this] { return unfinished == 0 && activeWorkers == 0; });
+        currentTask = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex loopMutex;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int)>* currentTask{ nullptr };
+    int taskCount{ 0 };
+    std::atomic<int> nextIndex{ 0 };
+    int unfinished{ 0 };
+    int activeWorkers{ 0 };
+    unsigned long generation{ 0 };
+    bool quit{ false };
+
+    // takes iterations until none are left, returns how many this thread ran
+    int runIterations(const std::function<void(int)>& task, int count)
+    {
+        int finished = 0;
+        for (int i = nextIndex++; i < count; i = nextIndex++)
+        {
+            task(i);
+            finished++;
+        }
+        return finished;
+    }
+
+    void workerLoop()
+    {
+        unsigned long seenGeneration = 0;
+        for (;;)
+        {
+            const std::function<void(int)>* task;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                wake.wait(lock, [&] { return quit || (generation != seenGeneration && currentTask != nullptr); });
+                if (quit)
+                    return;
+                seenGeneration = generation;
+                task = currentTask;
+                count = taskCount;
+                activeWorkers++;
+            }
+
+            int finished = runIterations(*task, count);
+
+            std::lock_guard<std::mutex> lock(stateMutex);
+            unfinished -= finished;
+            activeWorkers--;
+            if (unfinished == 0 && activeWorkers == 0)
+                done.notify_all();
+        }
+    }
+};
+#endif